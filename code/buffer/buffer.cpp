@@ -1,13 +1,20 @@
 #include "buffer.h"
 
-Buffer::Buffer(int initBufferSize): m_buffer(initBufferSize), m_readPos(0), m_writePos(0) {}
+Buffer::Buffer(int initBufferSize): m_data(nullptr), m_capacity(0), m_initSize(initBufferSize),
+                                    m_readPos(0), m_writePos(0) {}
+
+Buffer::~Buffer() {
+    if (m_data) {
+        BufferPool::release(m_data, m_capacity);
+    }
+}
 
 size_t Buffer::readableBytes() const {
     return m_writePos - m_readPos;
 }
 
 size_t Buffer::writableBytes() const {
-    return m_buffer.size() - m_writePos;
+    return m_capacity - m_writePos;
 }
 
 size_t Buffer::prependableBytes() const {
@@ -40,9 +47,20 @@ void Buffer::retrieveUntil(const char* end) {
 }
 
 void Buffer::retrieveAll() {
-    bzero(&m_buffer[0], m_buffer.size());
     m_readPos = 0;
     m_writePos = 0;
+    if (m_data) {
+        BufferPool::release(m_data, m_capacity);
+        m_data = nullptr;
+        m_capacity = 0;
+    }
+}
+
+void Buffer::erase(const char* begin, size_t len) {
+    assert(peek() <= begin && begin + len <= beginWriteConst());
+    char* dst = const_cast<char*>(begin);
+    memmove(dst, dst + len, beginWriteConst() - (begin + len));
+    m_writePos -= len;
 }
 
 std::string Buffer::retrieveAllToStr() {
@@ -59,7 +77,7 @@ char* Buffer::beginWrite() {
     return m_beginPtr() + m_writePos;
 }
 
-void Buffer::append(const std::string& str) {
+void Buffer::append(std::string_view str) {
     append(str.data(), str.length());
 }
 
@@ -80,14 +98,18 @@ void Buffer::append(const Buffer& buff) {
 }
 
 ssize_t Buffer::readFd(int fd, int* saveErrno) {
-    char buff[65535];
+    /*
+     * 放不下的部分先读到本线程共用的溢出区，不再每次在栈上占64KB
+     * 尚未挂块时整个读到溢出区，再按读到的大小挂块，不必从小块逐级扩容
+     */
+    static thread_local char spill[64 * 1024];
     struct iovec iov[2];
     const size_t writable = writableBytes();
     /* 分散读， 保证数据全部读完 */
     iov[0].iov_base = m_beginPtr() + m_writePos;
     iov[0].iov_len = writable;
-    iov[1].iov_base = buff;
-    iov[1].iov_len = sizeof(buff);
+    iov[1].iov_base = spill;
+    iov[1].iov_len = sizeof(spill);
 
     const ssize_t len = readv(fd, iov, 2);
     if (len < 0) {
@@ -95,8 +117,8 @@ ssize_t Buffer::readFd(int fd, int* saveErrno) {
     } else if (static_cast<size_t>(len) <= writable) {
         m_writePos += len;
     } else {
-        m_writePos = m_buffer.size();
-        append(buff, len - writable);
+        m_writePos = m_capacity;
+        append(spill, len - writable);
     }
     return len;
 }
@@ -113,21 +135,31 @@ ssize_t Buffer::writeFd(int fd, int* saveErrno) {
 }
 
 char* Buffer::m_beginPtr() {
-    return &*m_buffer.begin();
+    return m_data;
 }
 
 const char* Buffer::m_beginPtr() const {
-    return &*m_buffer.begin();
+    return m_data;
 }
 
 void Buffer::m_makeSpace(size_t len) {
+    size_t readable = readableBytes();
     if (writableBytes() + prependableBytes() < len) {
-        m_buffer.resize(m_writePos + len + 1);
+        /* 换一个至少大一倍的块，旧块还给池 */
+        size_t size = std::max(readable + len, m_capacity ? m_capacity * 2 : m_initSize);
+        char* block = BufferPool::acquire(size);
+        if (readable > 0) {
+            memcpy(block, m_beginPtr() + m_readPos, readable);
+        }
+        if (m_data) {
+            BufferPool::release(m_data, m_capacity);
+        }
+        m_data = block;
+        m_capacity = size;
     } else {
-        size_t readable = readableBytes();
         std::copy(m_beginPtr() + m_readPos, m_beginPtr() + m_writePos, m_beginPtr());
-        m_readPos = 0;
-        m_writePos = m_readPos + readable;
-        assert(readable == readableBytes());
     }
+    m_readPos = 0;
+    m_writePos = readable;
+    assert(readable == readableBytes());
 }
\ No newline at end of file
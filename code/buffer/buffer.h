@@ -2,17 +2,24 @@
 #define BUFFER_H
 
 #include <cstring>
+#include <string_view>
 #include <iostream>
 #include <unistd.h>
 #include <sys/uio.h>
 #include <vector>
-#include <atomic>
+#include <algorithm>
 #include <assert.h>
 
+#include "bufferpool.h"
+
+/*
+ * 存储块取自BufferPool，首次写入时才挂上，retrieveAll后归还
+ * initBuffSize为挂上的第一个块的大小，放不下时换成更大的块
+ */
 class Buffer {
     public:
         Buffer(int initBuffSize = 1024);
-        ~Buffer() = default;
+        ~Buffer();
 
         size_t readableBytes() const;
         size_t writableBytes() const;
@@ -24,13 +31,16 @@ class Buffer {
 
         void retrieve(size_t len);
         void retrieveUntil(const char* end);
+        /* 清空并把块还给池 */
         void retrieveAll();
+        /* 删除可读区中间的一段数据，其后的数据前移 */
+        void erase(const char* begin, size_t len);
         std::string retrieveAllToStr();
 
         const char* beginWriteConst() const;
         char* beginWrite();
 
-        void append(const std::string& str);
+        void append(std::string_view str);
         void append(const char* str, size_t len);
         void append(const void* data, size_t len);
         void append(const Buffer& buff);
@@ -43,9 +53,12 @@ class Buffer {
         const char* m_beginPtr() const;
         void m_makeSpace(size_t len);
 
-        std::vector<char> m_buffer;
-        std::atomic<std::size_t> m_readPos;
-        std::atomic<std::size_t> m_writePos;
+        char* m_data;
+        size_t m_capacity;
+        size_t m_initSize;
+        /* 一个缓冲区同一时刻只由一个线程使用，读写位置不需要原子操作 */
+        size_t m_readPos;
+        size_t m_writePos;
 };
 
 #endif  //BUFFER_H
\ No newline at end of file
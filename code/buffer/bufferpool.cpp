@@ -0,0 +1,85 @@
+#include "bufferpool.h"
+
+size_t BufferPool::maxCachedBytes = 4 * 1024 * 1024;
+std::atomic<uint64_t> BufferPool::m_hits(0);
+std::atomic<uint64_t> BufferPool::m_misses(0);
+std::atomic<size_t> BufferPool::m_resident(0);
+std::atomic<size_t> BufferPool::m_cached(0);
+
+/* 空闲块的开头存放下一个空闲块的地址 */
+struct ThreadCache {
+    char* heads[BufferPool::CLASS_COUNT] = {};
+    size_t bytes = 0;
+
+    ~ThreadCache();
+};
+
+/*
+ * 指针与标志是平凡类型，线程退出时不会被析构；
+ * 线程的缓存析构之后（如静态对象析构时）再归还的块直接释放
+ */
+static thread_local ThreadCache* threadCache = nullptr;
+static thread_local bool threadExited = false;
+
+ThreadCache::~ThreadCache() {
+    for (int cls = 0; cls < BufferPool::CLASS_COUNT; cls++) {
+        size_t size = BufferPool::MIN_BLOCK << cls;
+        while (char* block = heads[cls]) {
+            heads[cls] = *reinterpret_cast<char**>(block);
+            delete[] block;
+            BufferPool::m_resident -= size;
+            BufferPool::m_cached -= size;
+        }
+    }
+    threadCache = nullptr;
+    threadExited = true;
+}
+
+static ThreadCache* localCache() {
+    if (!threadCache && !threadExited) {
+        thread_local ThreadCache cache;
+        threadCache = &cache;
+    }
+    return threadCache;
+}
+
+int BufferPool::m_classOf(size_t size) {
+    int cls = 0;
+    while ((MIN_BLOCK << cls) < size) {
+        if (++cls == CLASS_COUNT) { return -1; }
+    }
+    return cls;
+}
+
+char* BufferPool::acquire(size_t& size) {
+    int cls = m_classOf(size);
+    ThreadCache* cache = localCache();
+    if (cls >= 0) {
+        size = MIN_BLOCK << cls;
+        if (cache && cache->heads[cls]) {
+            char* block = cache->heads[cls];
+            cache->heads[cls] = *reinterpret_cast<char**>(block);
+            cache->bytes -= size;
+            m_cached.fetch_sub(size, std::memory_order_relaxed);
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return block;
+        }
+    }
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    m_resident.fetch_add(size, std::memory_order_relaxed);
+    return new char[size];
+}
+
+void BufferPool::release(char* block, size_t size) {
+    int cls = m_classOf(size);
+    ThreadCache* cache = localCache();
+    if (cls >= 0 && (MIN_BLOCK << cls) == size && cache && cache->bytes + size <= maxCachedBytes) {
+        *reinterpret_cast<char**>(block) = cache->heads[cls];
+        cache->heads[cls] = block;
+        cache->bytes += size;
+        m_cached.fetch_add(size, std::memory_order_relaxed);
+        return;
+    }
+    delete[] block;
+    m_resident.fetch_sub(size, std::memory_order_relaxed);
+}
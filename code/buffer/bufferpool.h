@@ -0,0 +1,43 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 按2的幂分级的缓冲块池，每个线程各有一组空闲链表，取还都不加锁
+ * Buffer只在有数据时挂一个块，数据取完即归还，空闲的长连接不占缓冲内存
+ * 超过最大级别的块不入池，直接向系统申请与释放
+ */
+class BufferPool {
+    public:
+        static const size_t MIN_BLOCK = 1024;
+        static const size_t MAX_BLOCK = 1024 * 1024;
+        static const int CLASS_COUNT = 11;
+
+        /* 取一个不小于size的块，size中返回块的实际大小，归还时原样传回 */
+        static char* acquire(size_t& size);
+        static void release(char* block, size_t size);
+
+        /* 每个线程的空闲链表最多缓存的字节数，超出时归还的块直接释放 */
+        static size_t maxCachedBytes;
+
+        static uint64_t hits() { return m_hits.load(std::memory_order_relaxed); }
+        static uint64_t misses() { return m_misses.load(std::memory_order_relaxed); }
+        /* 已向系统申请且未释放的字节数，包括挂在缓冲区上的与缓存在空闲链表中的 */
+        static size_t residentBytes() { return m_resident.load(std::memory_order_relaxed); }
+        static size_t cachedBytes() { return m_cached.load(std::memory_order_relaxed); }
+
+    private:
+        friend struct ThreadCache;
+
+        static int m_classOf(size_t size);
+
+        static std::atomic<uint64_t> m_hits;
+        static std::atomic<uint64_t> m_misses;
+        static std::atomic<size_t> m_resident;
+        static std::atomic<size_t> m_cached;
+};
+
+#endif  //BUFFER_POOL_H
@@ -0,0 +1,125 @@
+#include "chainbuffer.h"
+
+#include <algorithm>
+#include <string.h>
+
+void ChainBuffer::append(const char* data, size_t len) {
+    while (len > 0) {
+        if (m_tailFree == 0) {
+            size_t size = std::max(len, m_blockSize);
+            char* block = BufferPool::acquire(size);
+            m_tailBlock.reset(block, [size](char* p) { BufferPool::release(p, size); });
+            m_tail = block;
+            m_tailFree = size;
+        }
+        size_t n = std::min(len, m_tailFree);
+        memcpy(m_tail, data, n);
+        /* 紧接着上次写入的位置时并入最后一段 */
+        if (!m_slices.empty() && m_slices.back().keeper == m_tailBlock
+                && m_slices.back().data + m_slices.back().len == m_tail) {
+            m_slices.back().len += n;
+            m_bytes += n;
+        } else {
+            m_push({ m_tailBlock, m_tail, -1, 0, n });
+        }
+        m_tail += n;
+        m_tailFree -= n;
+        data += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::appendRef(const char* data, size_t len, std::shared_ptr<const void> keeper) {
+    if (len > 0) {
+        m_push({ std::move(keeper), data, -1, 0, len });
+    }
+}
+
+void ChainBuffer::appendFile(int fd, off_t off, size_t len, std::shared_ptr<const void> keeper) {
+    assert(fd >= 0);
+    if (len > 0) {
+        m_push({ std::move(keeper), nullptr, fd, off, len });
+    }
+}
+
+void ChainBuffer::m_push(Slice&& slice) {
+    m_bytes += slice.len;
+    m_slices.push_back(std::move(slice));
+}
+
+int ChainBuffer::peekIov(struct iovec* iov, int maxIov, bool* more) const {
+    int cnt = 0;
+    size_t i = 0;
+    for (; i < m_slices.size() && m_slices[i].fd < 0 && cnt < maxIov; i++, cnt++) {
+        iov[cnt].iov_base = const_cast<char*>(m_slices[i].data);
+        iov[cnt].iov_len = m_slices[i].len;
+    }
+    if (more) {
+        *more = i < m_slices.size();
+    }
+    return cnt;
+}
+
+bool ChainBuffer::peekFile(int& fd, off_t& off, size_t& len) const {
+    if (m_slices.empty() || m_slices.front().fd < 0) {
+        return false;
+    }
+    const Slice& front = m_slices.front();
+    fd = front.fd;
+    off = front.off;
+    len = front.len;
+    return true;
+}
+
+void ChainBuffer::retrieve(size_t len) {
+    assert(len <= m_bytes);
+    m_bytes -= len;
+    while (len > 0) {
+        Slice& front = m_slices.front();
+        if (len < front.len) {
+            /* 只推进写了一部分的段 */
+            if (front.fd < 0) {
+                front.data += len;
+            } else {
+                front.off += len;
+            }
+            front.len -= len;
+            return;
+        }
+        len -= front.len;
+        m_slices.pop_front();
+    }
+    if (m_bytes == 0) {
+        /* 全部取完，自有块还给池 */
+        clear();
+    }
+}
+
+void ChainBuffer::split(size_t len, ChainBuffer& head) {
+    assert(len <= m_bytes);
+    while (len > 0) {
+        Slice& front = m_slices.front();
+        if (len < front.len) {
+            /* 跨段处两边各引用一部分 */
+            Slice part = front;
+            part.len = len;
+            head.m_push(std::move(part));
+            retrieve(len);
+            return;
+        }
+        len -= front.len;
+        m_bytes -= front.len;
+        head.m_push(std::move(front));
+        m_slices.pop_front();
+    }
+    if (m_bytes == 0) {
+        clear();
+    }
+}
+
+void ChainBuffer::clear() {
+    m_slices.clear();
+    m_bytes = 0;
+    m_tailBlock.reset();
+    m_tailFree = 0;
+}
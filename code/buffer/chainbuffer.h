@@ -0,0 +1,71 @@
+#ifndef CHAIN_BUFFER_H
+#define CHAIN_BUFFER_H
+
+#include <deque>
+#include <memory>
+#include <string_view>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <assert.h>
+
+#include "bufferpool.h"
+
+/*
+ * 由若干段组成的发送缓冲区：自有的字节存放在BufferPool的块中，写满后另起一块，已有数据从不搬移；
+ * 也可以直接引用外部内存（缓存的文件内容、首部模板）或文件区间，keeper保证引用期间外部数据不被释放
+ * 块以引用计数共享，split与retrieve只调整段的边界，不拷贝数据
+ */
+class ChainBuffer {
+    public:
+        ChainBuffer(size_t blockSize = 4096): m_bytes(0), m_blockSize(blockSize), m_tail(nullptr), m_tailFree(0) {}
+
+        size_t readableBytes() const { return m_bytes; }
+        bool empty() const { return m_bytes == 0; }
+        size_t segmentCount() const { return m_slices.size(); }
+
+        /* 拷贝到自有块中 */
+        void append(const char* data, size_t len);
+        void append(std::string_view str) { append(str.data(), str.size()); }
+
+        /* 不拷贝；keeper为空时由调用方保证数据在发送完之前有效 */
+        void appendRef(const char* data, size_t len, std::shared_ptr<const void> keeper = nullptr);
+        void appendFile(int fd, off_t off, size_t len, std::shared_ptr<const void> keeper = nullptr);
+
+        /*
+         * 从头取连续的内存段填入iov，遇到文件段为止，返回填入的个数
+         * more中返回其后是否还有数据（可据此设置MSG_MORE）
+         */
+        int peekIov(struct iovec* iov, int maxIov, bool* more = nullptr) const;
+
+        /* 第一段是文件区间时返回true */
+        bool peekFile(int& fd, off_t& off, size_t& len) const;
+
+        void retrieve(size_t len);
+
+        /* 把前len字节移到head末尾 */
+        void split(size_t len, ChainBuffer& head);
+
+        void clear();
+
+    private:
+        struct Slice {
+            std::shared_ptr<const void> keeper;
+            const char* data;
+            int fd;         /* >=0 时为文件区间 */
+            off_t off;
+            size_t len;
+        };
+
+        void m_push(Slice&& slice);
+
+        std::deque<Slice> m_slices;
+        size_t m_bytes;
+        size_t m_blockSize;
+
+        /* 最后一个自有块中尚未写入的部分 */
+        std::shared_ptr<char> m_tailBlock;
+        char* m_tail;
+        size_t m_tailFree;
+};
+
+#endif  //CHAIN_BUFFER_H
@@ -0,0 +1,258 @@
+#include "assetpack.h"
+
+#include <algorithm>
+#include <vector>
+#include <dirent.h>
+
+using namespace std;
+
+static const char PACK_MAGIC[8] = "WSPACK1";
+static const char* ENCODING_SUFFIX[FileCache::ENCODING_COUNT] = { "", ".gz", ".br" };
+
+static size_t alignUp(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+static bool writeAt(int fd, const char* data, size_t len, off_t off) {
+    while (len > 0) {
+        ssize_t ret = pwrite(fd, data, len, off);
+        if (ret <= 0) { return false; }
+        data += ret;
+        len -= ret;
+        off += ret;
+    }
+    return true;
+}
+
+static bool readFile(const string& path, string& out) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { return false; }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok) {
+        out.resize(st.st_size);
+        off_t off = 0;
+        while (off < st.st_size) {
+            ssize_t len = pread(fd, &out[off], st.st_size - off, off);
+            if (len <= 0) { ok = false; break; }
+            off += len;
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+/* 递归列出dir下的普通文件，rel为相对资源目录的路径 */
+static void listFiles(const string& dir, const string& rel, vector<string>& files) {
+    DIR* dp = opendir(dir.c_str());
+    if (!dp) { return; }
+    while (struct dirent* ent = readdir(dp)) {
+        if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) { continue; }
+        struct stat st;
+        string path = dir + "/" + ent->d_name;
+        if (stat(path.c_str(), &st) < 0) { continue; }
+        if (S_ISDIR(st.st_mode)) {
+            listFiles(path, rel + "/" + ent->d_name, files);
+        } else if (S_ISREG(st.st_mode)) {
+            files.push_back(rel + "/" + ent->d_name);
+        }
+    }
+    closedir(dp);
+}
+
+AssetPack::~AssetPack() {
+    if (m_base) { munmap(const_cast<char*>(m_base), m_size); }
+}
+
+uint64_t AssetPack::hash(string_view data) {
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char ch: data) {
+        h ^= ch;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+shared_ptr<AssetPack> AssetPack::open(const string& packPath) {
+    int fd = ::open(packPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("Open pack %s failed, errno:%d", packPath.c_str(), errno);
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(PackHeader)) {
+        LOG_ERROR("Pack %s too short", packPath.c_str());
+        close(fd);
+        return nullptr;
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* 映射建立后fd不再需要 */
+    close(fd);
+    if (base == MAP_FAILED) {
+        LOG_ERROR("Mmap pack %s failed, errno:%d", packPath.c_str(), errno);
+        return nullptr;
+    }
+    shared_ptr<AssetPack> pack(new AssetPack());
+    pack->m_base = static_cast<const char*>(base);
+    pack->m_size = st.st_size;
+    pack->m_header = reinterpret_cast<const PackHeader*>(base);
+    if (!pack->m_verify()) {
+        LOG_ERROR("Pack %s is corrupt", packPath.c_str());
+        return nullptr;
+    }
+    pack->m_slots = reinterpret_cast<const uint32_t*>(pack->m_base + pack->m_header->slotOff);
+    pack->m_entries = reinterpret_cast<const PackEntry*>(pack->m_base + pack->m_header->entryOff);
+    return pack;
+}
+
+bool AssetPack::m_verify() const {
+    /* 打开时校验一次全部偏移，之后的查找不再做边界检查 */
+    const PackHeader& h = *m_header;
+    if (memcmp(h.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) || h.version != VERSION || h.fileSize != m_size) {
+        return false;
+    }
+    /* 查找靠空槽终止线性探测，槽数不足条目数两倍的包一律拒绝 */
+    if (h.slotNum == 0 || (h.slotNum & (h.slotNum - 1)) || h.slotNum < 2 * uint64_t(h.count)) {
+        return false;
+    }
+    if (h.slotOff % alignof(uint32_t) || h.entryOff % alignof(PackEntry)
+            || h.slotOff + uint64_t(h.slotNum) * sizeof(uint32_t) > m_size
+            || h.entryOff + uint64_t(h.count) * sizeof(PackEntry) > m_size
+            || h.strOff > m_size || h.strLen > m_size - h.strOff) {
+        return false;
+    }
+    const uint32_t* slots = reinterpret_cast<const uint32_t*>(m_base + h.slotOff);
+    for (uint32_t i = 0; i < h.slotNum; i++) {
+        if (slots[i] > h.count) { return false; }
+    }
+    const PackEntry* entries = reinterpret_cast<const PackEntry*>(m_base + h.entryOff);
+    for (uint32_t i = 0; i < h.count; i++) {
+        const PackEntry& e = entries[i];
+        if (uint64_t(e.pathOff) + e.pathLen > h.strLen || uint64_t(e.etagOff) + e.etagLen > h.strLen) {
+            return false;
+        }
+        for (int enc = 0; enc < FileCache::ENCODING_COUNT; enc++) {
+            if (e.off[enc] > m_size || e.len[enc] > m_size - e.off[enc]) { return false; }
+        }
+    }
+    return true;
+}
+
+const PackEntry* AssetPack::find(string_view path) const {
+    uint64_t h = hash(path);
+    uint32_t mask = m_header->slotNum - 1;
+    /* 线性探测，槽数不少于条目数两倍，总能遇到空槽 */
+    for (uint32_t i = h & mask; m_slots[i]; i = (i + 1) & mask) {
+        const PackEntry& entry = m_entries[m_slots[i] - 1];
+        if (entry.hash == h && this->path(entry) == path) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool AssetPack::build(const string& srcDir, const string& packPath) {
+    string root = srcDir;
+    while (root.size() > 1 && root.back() == '/') { root.pop_back(); }
+    vector<string> files;
+    listFiles(root, "", files);
+    /* 包文件本身放在资源目录下时不打包进去 */
+    struct stat self;
+    if (stat(packPath.c_str(), &self) == 0) {
+        files.erase(remove_if(files.begin(), files.end(), [&](const string& rel) {
+            struct stat st;
+            return stat((root + rel).c_str(), &st) == 0 && st.st_dev == self.st_dev && st.st_ino == self.st_ino;
+        }), files.end());
+    }
+    sort(files.begin(), files.end());
+
+    /* ETag长度固定，索引部分的大小在读文件前就能确定，内容随读随写 */
+    const size_t ETAG_LEN = 18;
+    PackHeader header = {};
+    memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = VERSION;
+    header.count = files.size();
+    header.slotNum = 16;
+    while (header.slotNum < files.size() * 2) { header.slotNum <<= 1; }
+    header.slotOff = alignUp(sizeof(PackHeader), ALIGN);
+    header.entryOff = alignUp(header.slotOff + header.slotNum * sizeof(uint32_t), ALIGN);
+    header.strOff = header.entryOff + files.size() * sizeof(PackEntry);
+    string strs;
+    vector<PackEntry> entries(files.size());
+    vector<uint32_t> slots(header.slotNum, 0);
+    for (size_t i = 0; i < files.size(); i++) {
+        PackEntry& e = entries[i];
+        e.hash = hash(files[i]);
+        e.pathOff = strs.size();
+        e.pathLen = files[i].size();
+        strs += files[i];
+        e.etagOff = strs.size();
+        e.etagLen = ETAG_LEN;
+        strs.append(ETAG_LEN, '"');
+        uint32_t slot = e.hash & (header.slotNum - 1);
+        while (slots[slot]) { slot = (slot + 1) & (header.slotNum - 1); }
+        slots[slot] = i + 1;
+    }
+    header.strLen = strs.size();
+
+    string tmpPath = packPath + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Create %s failed, errno:%d", tmpPath.c_str(), errno);
+        return false;
+    }
+    bool ok = true;
+    size_t off = alignUp(header.strOff + header.strLen, ALIGN);
+    for (size_t i = 0; ok && i < files.size(); i++) {
+        PackEntry& e = entries[i];
+        string path = root + files[i];
+        struct stat st;
+        if (stat(path.c_str(), &st) < 0) { ok = false; break; }
+        e.mtimeSec = st.st_mtim.tv_sec;
+        e.mtimeNsec = st.st_mtim.tv_nsec;
+        e.mode = st.st_mode & 07777;
+        string content[FileCache::ENCODING_COUNT];
+        /* 其他用户不可读的文件只记录元数据，服务端对其返回403 */
+        if ((st.st_mode & S_IROTH) && !readFile(path, content[FileCache::IDENTITY])) { ok = false; break; }
+        const string& raw = content[FileCache::IDENTITY];
+        char etag[ETAG_LEN + 1];
+        snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long)hash(raw));
+        memcpy(&strs[e.etagOff], etag, ETAG_LEN);
+        for (int enc = FileCache::GZIP; enc < FileCache::ENCODING_COUNT && !raw.empty(); enc++) {
+            /* 与服务端一致，优先用不旧于原文件的预压缩文件 */
+            struct stat sibling;
+            string siblingPath = path + ENCODING_SUFFIX[enc];
+            if (stat(siblingPath.c_str(), &sibling) == 0 && S_ISREG(sibling.st_mode)
+                    && sibling.st_mtime >= st.st_mtime && readFile(siblingPath, content[enc])) {
+                continue;
+            }
+            if (raw.size() > FileCache::maxCompressSize
+                    || !FileCache::compress(raw.data(), raw.size(), static_cast<FileCache::ENCODING>(enc), content[enc])
+                    || content[enc].size() >= raw.size() / 10 * 9) {
+                content[enc].clear();
+            }
+        }
+        for (int enc = 0; enc < FileCache::ENCODING_COUNT; enc++) {
+            e.off[enc] = off;
+            e.len[enc] = content[enc].size();
+            if (!writeAt(fd, content[enc].data(), content[enc].size(), off)) { ok = false; break; }
+            off = alignUp(off + content[enc].size(), ALIGN);
+        }
+    }
+    header.fileSize = off;
+    ok = ok && ftruncate(fd, off) == 0
+         && writeAt(fd, reinterpret_cast<const char*>(&header), sizeof(header), 0)
+         && writeAt(fd, reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(uint32_t), header.slotOff)
+         && writeAt(fd, reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PackEntry), header.entryOff)
+         && writeAt(fd, strs.data(), strs.size(), header.strOff)
+         && fsync(fd) == 0;
+    close(fd);
+    /* rename是原子的，服务端看到的要么是旧包要么是完整的新包 */
+    if (!ok || rename(tmpPath.c_str(), packPath.c_str()) < 0) {
+        LOG_ERROR("Write pack %s failed, errno:%d", packPath.c_str(), errno);
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    LOG_INFO("Pack %s: %zu files, %zu bytes", packPath.c_str(), files.size(), off);
+    return true;
+}
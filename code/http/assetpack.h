@@ -0,0 +1,89 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <stdint.h>
+#include <fcntl.h>         // open
+#include <unistd.h>        // close
+#include <sys/mman.h>      // mmap, munmap
+#include <sys/stat.h>
+
+#include "filecache.h"
+
+/*
+ * 资源包：把资源目录打包成一个只读文件，整体mmap后按路径散列查找
+ * 布局：PackHeader | 散列槽 | 条目表 | 字符串区（路径与ETag）| 文件内容（按ALIGN对齐）
+ * 每个文件可带预先压缩好的gzip/br版本；多字节字段按本机字节序存放，只在同构机器间部署
+ */
+struct PackHeader {
+    char magic[8];          /* "WSPACK1" */
+    uint32_t version;
+    uint32_t count;         /* 条目数 */
+    uint32_t slotNum;       /* 散列槽数，2的幂，不少于条目数的两倍 */
+    uint32_t reserved;
+    uint64_t slotOff;       /* uint32_t[slotNum]，存条目下标+1，0为空槽 */
+    uint64_t entryOff;      /* PackEntry[count] */
+    uint64_t strOff;
+    uint64_t strLen;
+    uint64_t fileSize;      /* 截断的包据此识别 */
+};
+
+struct PackEntry {
+    uint64_t hash;          /* 路径的FNV-1a */
+    uint32_t pathOff;       /* 相对资源目录，以'/'开头 */
+    uint32_t pathLen;
+    uint32_t etagOff;       /* 按原文件内容生成，含引号，重新打包内容不变时不变 */
+    uint32_t etagLen;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    uint32_t mode;          /* 原文件的权限位 */
+    uint32_t reserved;
+    uint64_t off[FileCache::ENCODING_COUNT];  /* 按编码存放的内容位置 */
+    uint64_t len[FileCache::ENCODING_COUNT];  /* 压缩版本长度为0表示没有该版本 */
+};
+
+class AssetPack {
+    public:
+        static const uint32_t VERSION = 1;
+        static const size_t ALIGN = 64;
+
+        ~AssetPack();
+
+        /* 映射并校验整个包，失败返回nullptr */
+        static std::shared_ptr<AssetPack> open(const std::string& packPath);
+
+        /*
+         * 打包srcDir下的全部普通文件，压缩后不小于原文件90%的版本不保留
+         * 先写入临时文件再rename，正在使用旧包的服务进程不受影响
+         */
+        static bool build(const std::string& srcDir, const std::string& packPath);
+
+        const PackEntry* find(std::string_view path) const;
+
+        size_t count() const { return m_header->count; }
+        const char* data(const PackEntry& entry, FileCache::ENCODING encoding) const {
+            return m_base + entry.off[encoding];
+        }
+        std::string_view path(const PackEntry& entry) const {
+            return std::string_view(m_base + m_header->strOff + entry.pathOff, entry.pathLen);
+        }
+        std::string_view etag(const PackEntry& entry) const {
+            return std::string_view(m_base + m_header->strOff + entry.etagOff, entry.etagLen);
+        }
+
+        static uint64_t hash(std::string_view data);
+
+    private:
+        AssetPack(): m_base(nullptr), m_size(0), m_header(nullptr), m_slots(nullptr), m_entries(nullptr) {}
+        bool m_verify() const;
+
+        const char* m_base;
+        size_t m_size;
+        const PackHeader* m_header;
+        const uint32_t* m_slots;
+        const PackEntry* m_entries;
+};
+
+#endif  //ASSET_PACK_H
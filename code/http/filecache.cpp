@@ -0,0 +1,463 @@
+#include "filecache.h"
+#include "assetpack.h"
+
+#include <zlib.h>
+#include <brotli/encode.h>
+
+using namespace std;
+
+size_t FileCache::sendfileThreshold = 16 * 1024;
+size_t FileCache::maxCompressSize = 8 * 1024 * 1024;
+
+static const char* ENCODING_SUFFIX[FileCache::ENCODING_COUNT] = { "", ".gz", ".br" };
+
+FileCache::FileCache() {
+    m_isOpen = false;
+    m_inotifyFd = -1;
+    m_wakeupFd = -1;
+    m_packed = false;
+    m_packWd = -1;
+    m_compressStop = false;
+    m_compressions = 0;
+}
+
+FileCache::~FileCache() {
+    if (m_compressThread && m_compressThread->joinable()) {
+        {
+            lock_guard<mutex> locker(m_compressMtx);
+            m_compressStop = true;
+        }
+        m_compressCond.notify_one();
+        m_compressThread->join();
+    }
+    if (m_watchThread && m_watchThread->joinable()) {
+        uint64_t one = 1;
+        ssize_t ret = ::write(m_wakeupFd, &one, sizeof(one));
+        (void)ret;
+        m_watchThread->join();
+    }
+    if (m_inotifyFd >= 0) { close(m_inotifyFd); }
+    if (m_wakeupFd >= 0) { close(m_wakeupFd); }
+}
+
+FileCache* FileCache::getInstance() {
+    static FileCache fileCache;
+    return &fileCache;
+}
+
+void FileCache::init(const string& root, size_t maxBytes, size_t maxEntries, size_t shardNum) {
+    assert(shardNum > 0);
+    if (m_isOpen) { return; }
+    m_root = root;
+    while (m_root.size() > 1 && m_root.back() == '/') { m_root.pop_back(); }
+    m_lru.init(shardNum, maxBytes, maxEntries);
+
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    m_wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_inotifyFd < 0 || m_wakeupFd < 0) {
+        LOG_WARN("inotify unavailable, file cache disabled");
+        return;
+    }
+    m_watchDir(m_root);
+    m_isOpen = true;
+    m_watchThread.reset(new thread(&FileCache::m_watchLoop, this));
+    m_compressThread.reset(new thread(&FileCache::m_compressLoop, this));
+    LOG_INFO("File cache: %s, %zu shards, %zu MB", m_root.c_str(), shardNum, maxBytes >> 20);
+}
+
+bool FileCache::loadPack(const string& packPath) {
+    shared_ptr<const AssetPack> pack = AssetPack::open(packPath);
+    if (!pack) {
+        return false;
+    }
+    /* 先换包再清空：清空使各分片代数增加，换包前开始加载的旧包条目不会再被放入 */
+    atomic_store(&m_pack, pack);
+    bool first = !m_packed.exchange(true);
+    clear();
+    LOG_INFO("Asset pack %s: %zu files", packPath.c_str(), pack->count());
+    if (!first || !m_isOpen) {
+        return true;
+    }
+    size_t pos = packPath.rfind('/');
+    string dir = (pos == string::npos) ? "." : (pos == 0 ? "/" : packPath.substr(0, pos));
+    int wd = inotify_add_watch(m_inotifyFd, dir.c_str(), IN_MOVED_TO | IN_ONLYDIR | IN_MASK_ADD);
+    if (wd < 0) {
+        LOG_WARN("inotify watch %s failed, errno:%d, pack reload disabled", dir.c_str(), errno);
+        return true;
+    }
+    lock_guard<mutex> locker(m_watchMtx);
+    m_packPath = packPath;
+    m_packName = packPath.substr(pos + 1);
+    m_packWd = wd;
+    m_watchDirs.emplace(wd, dir);
+    return true;
+}
+
+shared_ptr<const FileEntry> FileCache::get(const string& rawPath) {
+    if (!m_isOpen && !m_packed) {
+        return m_load(rawPath);
+    }
+    string path = m_normalize(rawPath);
+    if (!m_cacheable(path)) {
+        /* 资源包模式下不访问文件系统 */
+        return m_packed ? make_shared<FileEntry>() : m_load(path);
+    }
+    shared_ptr<const FileEntry> entry;
+    uint64_t gen;
+    if (m_lru.get(path, entry, &gen)) {
+        return entry;
+    }
+    /* 加载在锁外进行 */
+    shared_ptr<FileEntry> loaded = m_packed ? m_loadPacked(atomic_load(&m_pack), path.substr(m_root.size()), IDENTITY)
+                                            : m_load(path);
+    loaded->watched = true;
+    m_lru.put(path, loaded, m_cost(*loaded), gen);
+    return loaded;
+}
+
+shared_ptr<const FileEntry> FileCache::getEncoded(const string& rawPath,
+                const shared_ptr<const FileEntry>& src, ENCODING encoding) {
+    assert(encoding > IDENTITY && encoding < ENCODING_COUNT);
+    if (!m_packed) {
+        /* 预压缩的兄弟文件，比原文件旧的视为过期不用 */
+        shared_ptr<const FileEntry> sibling = get(rawPath + ENCODING_SUFFIX[encoding]);
+        if (sibling->exists && (sibling->data || sibling->fd >= 0)
+                && sibling->st.st_mtime >= src->st.st_mtime) {
+            return sibling;
+        }
+    }
+    string path = m_normalize(rawPath);
+    if ((!m_isOpen && !m_packed) || !m_cacheable(path) || !src->watched) {
+        /* 无法感知文件变化时不缓存，也就不做即时压缩 */
+        return make_shared<FileEntry>();
+    }
+    string key = m_encodedKey(path, encoding);
+    shared_ptr<const FileEntry> entry;
+    uint64_t gen;
+    if (m_lru.get(key, entry, &gen, [](const shared_ptr<const FileEntry>& e) { return !e->stale; })) {
+        return entry;
+    }
+    if (m_packed) {
+        /* 资源包中的压缩版本取自原文件所在的包，不需要压缩 */
+        shared_ptr<FileEntry> packed = m_loadPacked(src->pack, path.substr(m_root.size()), encoding);
+        packed->watched = true;
+        m_lru.put(key, packed, m_cost(*packed), gen);
+        return packed;
+    }
+    /*
+     * 压缩（brotli可达每秒几MB）不在事件循环线程上做：交给压缩线程，本次先发送原文件
+     * 同一个键已在压缩中时不重复提交，并发的未命中只压缩一次；队列满时放弃，之后的请求再提交
+     */
+    {
+        lock_guard<mutex> locker(m_compressMtx);
+        if (m_compressTasks.size() < MAX_COMPRESS_TASKS && m_compressing.insert(key).second) {
+            m_compressTasks.push_back({ key, src, encoding, gen });
+            m_compressCond.notify_one();
+        }
+    }
+    return make_shared<FileEntry>();
+}
+
+void FileCache::m_compressLoop() {
+    unique_lock<mutex> locker(m_compressMtx);
+    while (!m_compressStop) {
+        if (m_compressTasks.empty()) {
+            m_compressCond.wait(locker);
+            continue;
+        }
+        CompressTask task = std::move(m_compressTasks.front());
+        m_compressTasks.pop_front();
+        locker.unlock();
+        /* 压缩期间文件失效时分片代数已变，put不会放入过期的结果 */
+        shared_ptr<FileEntry> compressed = m_compress(*task.src, task.encoding);
+        compressed->watched = true;
+        m_lru.put(task.key, compressed, m_cost(*compressed), task.gen);
+        m_compressions.fetch_add(1, memory_order_relaxed);
+        LOG_DEBUG("Compress %.*s %s: %lld -> %lld", static_cast<int>(task.key.rfind('\n')), task.key.c_str(),
+                        encodingName(task.encoding), (long long)task.src->st.st_size, (long long)compressed->st.st_size);
+        if (task.src->stale) {
+            /* 压缩期间原文件已变化 */
+            compressed->stale = true;
+        }
+        locker.lock();
+        /* 结果放入之后才移出，其间的请求不会重复提交 */
+        m_compressing.erase(task.key);
+    }
+}
+
+const char* FileCache::encodingName(ENCODING encoding) {
+    static const char* NAME[ENCODING_COUNT] = { "identity", "gzip", "br" };
+    return NAME[encoding];
+}
+
+void FileCache::invalidate(const string& rawPath) {
+    if (m_lru.empty()) { return; }
+    LOG_DEBUG("File cache invalidate %s", rawPath.c_str());
+    auto markStale = [](const shared_ptr<const FileEntry>& entry) {
+        entry->stale = true;
+    };
+    string path = m_normalize(rawPath);
+    m_lru.erase(path, markStale);
+    /* 原文件或其预压缩文件变化时，即时压缩的结果一并失效 */
+    string base = path;
+    for (int enc = GZIP; enc < ENCODING_COUNT; enc++) {
+        const char* suffix = ENCODING_SUFFIX[enc];
+        size_t len = strlen(suffix);
+        if (path.size() > len && path.compare(path.size() - len, len, suffix) == 0) {
+            base = path.substr(0, path.size() - len);
+        }
+    }
+    for (int enc = GZIP; enc < ENCODING_COUNT; enc++) {
+        m_lru.erase(m_encodedKey(base, static_cast<ENCODING>(enc)), markStale);
+    }
+}
+
+void FileCache::clear() {
+    m_lru.clear([](const shared_ptr<const FileEntry>& entry) {
+        entry->stale = true;
+    });
+}
+
+string FileCache::m_normalize(const string& path) {
+    /* 合并重复的'/'，与inotify上报的路径一致 */
+    string key;
+    key.reserve(path.size());
+    for (char ch: path) {
+        if (ch == '/' && !key.empty() && key.back() == '/') { continue; }
+        key.push_back(ch);
+    }
+    return key;
+}
+
+bool FileCache::m_cacheable(const string& path) const {
+    /* 只缓存inotify监听范围内的路径 */
+    return path.size() > m_root.size() && path.compare(0, m_root.size(), m_root) == 0
+           && path[m_root.size()] == '/' && path.find("/..") == string::npos;
+}
+
+shared_ptr<FileEntry> FileCache::m_load(const string& path) {
+    shared_ptr<FileEntry> entry = make_shared<FileEntry>();
+    if (stat(path.data(), &entry->st) < 0) {
+        return entry;
+    }
+    entry->exists = true;
+    m_setValidators(*entry);
+    if (!S_ISREG(entry->st.st_mode) || !(entry->st.st_mode & S_IROTH) || entry->st.st_size == 0) {
+        return entry;
+    }
+    int fd = open(path.data(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return entry;
+    }
+    if (static_cast<size_t>(entry->st.st_size) >= sendfileThreshold) {
+        /* 大文件由sendfile直接从页缓存发往socket，按顺序读取，让内核加大预读 */
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        entry->fd = fd;
+        return entry;
+    }
+    /* 小文件常驻内存，命中后不再有mmap/munmap */
+    char* data = new char[entry->st.st_size];
+    off_t off = 0;
+    while (off < entry->st.st_size) {
+        ssize_t len = pread(fd, data + off, entry->st.st_size - off, off);
+        if (len <= 0) { break; }
+        off += len;
+    }
+    close(fd);
+    if (off == entry->st.st_size) {
+        entry->data = data;
+    } else {
+        delete[] data;
+    }
+    return entry;
+}
+
+void FileCache::m_setValidators(FileEntry& entry) {
+    /* 只在加载时生成一次，命中后直接使用 */
+    char buf[96];
+    snprintf(buf, sizeof(buf), "\"%lx-%lx-%lx.%lx\"", (unsigned long)entry.st.st_ino, (unsigned long)entry.st.st_size,
+             (unsigned long)entry.st.st_mtim.tv_sec, (unsigned long)entry.st.st_mtim.tv_nsec);
+    entry.etag = buf;
+    struct tm tm;
+    gmtime_r(&entry.st.st_mtime, &tm);
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    entry.lastModified = buf;
+}
+
+bool FileCache::m_readAll(const FileEntry& src, string& out) {
+    if (src.data) {
+        out.assign(src.data, src.st.st_size);
+        return true;
+    }
+    if (src.fd < 0) {
+        return false;
+    }
+    out.resize(src.st.st_size);
+    off_t off = 0;
+    while (off < src.st.st_size) {
+        ssize_t len = pread(src.fd, &out[off], src.st.st_size - off, off);
+        if (len <= 0) { return false; }
+        off += len;
+    }
+    return true;
+}
+
+bool FileCache::compress(const char* data, size_t len, ENCODING encoding, string& out) {
+    size_t bound = (encoding == BROTLI) ? BrotliEncoderMaxCompressedSize(len) : compressBound(len) + 32;
+    out.resize(bound);
+    size_t outLen = 0;
+    bool ok = false;
+    if (encoding == BROTLI) {
+        outLen = bound;
+        ok = BrotliEncoderCompress(9, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, len,
+                    reinterpret_cast<const uint8_t*>(data), &outLen, reinterpret_cast<uint8_t*>(&out[0]));
+    } else {
+        /* windowBits 加16 输出gzip格式 */
+        z_stream zs = {};
+        if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) == Z_OK) {
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            zs.avail_in = len;
+            zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+            zs.avail_out = bound;
+            ok = (deflate(&zs, Z_FINISH) == Z_STREAM_END);
+            outLen = zs.total_out;
+            deflateEnd(&zs);
+        }
+    }
+    if (!ok || outLen >= len) {
+        out.clear();
+        return false;
+    }
+    out.resize(outLen);
+    return true;
+}
+
+shared_ptr<FileEntry> FileCache::m_compress(const FileEntry& src, ENCODING encoding) {
+    shared_ptr<FileEntry> entry = make_shared<FileEntry>();
+    string raw, out;
+    if (!S_ISREG(src.st.st_mode) || static_cast<size_t>(src.st.st_size) > maxCompressSize || !m_readAll(src, raw)
+            || !compress(raw.data(), raw.size(), encoding, out)) {
+        /* 压缩失败或不能变小，同样缓存结果，之后直接发送原文件 */
+        return entry;
+    }
+    entry->exists = true;
+    entry->data = new char[out.size()];
+    memcpy(entry->data, out.data(), out.size());
+    entry->st = src.st;
+    entry->st.st_size = out.size();
+    entry->etag = m_encodedEtag(src.etag, encoding);
+    entry->lastModified = src.lastModified;
+    return entry;
+}
+
+shared_ptr<FileEntry> FileCache::m_loadPacked(const shared_ptr<const AssetPack>& pack, const string& key,
+                ENCODING encoding) {
+    shared_ptr<FileEntry> entry = make_shared<FileEntry>();
+    const PackEntry* packed = pack ? pack->find(key) : nullptr;
+    if (!packed || (encoding != IDENTITY && packed->len[encoding] == 0)) {
+        return entry;
+    }
+    entry->exists = true;
+    entry->st.st_mode = S_IFREG | packed->mode;
+    entry->st.st_size = packed->len[encoding];
+    entry->st.st_mtim.tv_sec = packed->mtimeSec;
+    entry->st.st_mtim.tv_nsec = packed->mtimeNsec;
+    if (entry->st.st_size > 0) {
+        /* 内容不拷贝，条目持有包的引用 */
+        entry->data = const_cast<char*>(pack->data(*packed, encoding));
+        entry->pack = pack;
+    }
+    m_setValidators(*entry);
+    entry->etag = string(pack->etag(*packed));
+    if (encoding != IDENTITY) {
+        entry->etag = m_encodedEtag(entry->etag, encoding);
+    }
+    return entry;
+}
+
+size_t FileCache::m_cost(const FileEntry& entry) {
+    /* 只有读入内存的内容计入上限，sendfile的文件由页缓存负责 */
+    return sizeof(FileEntry) + (entry.data && !entry.pack ? entry.st.st_size : 0);
+}
+
+void FileCache::m_watchDir(const string& dir) {
+    int wd = inotify_add_watch(m_inotifyFd, dir.c_str(),
+                IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    if (wd < 0) {
+        LOG_WARN("inotify watch %s failed, errno:%d", dir.c_str(), errno);
+        return;
+    }
+    {
+        lock_guard<mutex> locker(m_watchMtx);
+        m_watchDirs[wd] = dir;
+    }
+    /* 递归监听子目录 */
+    DIR* dp = opendir(dir.c_str());
+    if (!dp) { return; }
+    while (struct dirent* ent = readdir(dp)) {
+        if (ent->d_type == DT_DIR && strcmp(ent->d_name, ".") && strcmp(ent->d_name, "..")) {
+            m_watchDir(dir + "/" + ent->d_name);
+        }
+    }
+    closedir(dp);
+}
+
+void FileCache::m_watchLoop() {
+    alignas(struct inotify_event) char buf[4096];
+    struct pollfd fds[2] = { { m_inotifyFd, POLLIN, 0 }, { m_wakeupFd, POLLIN, 0 } };
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) { continue; }
+            break;
+        }
+        if (fds[1].revents) { break; }
+        ssize_t len;
+        while ((len = read(m_inotifyFd, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + len; ) {
+                struct inotify_event* ev = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + ev->len;
+                if (ev->mask & IN_Q_OVERFLOW) {
+                    /* 事件丢失，无法判断哪些文件变了 */
+                    clear();
+                    continue;
+                }
+                string dir, packPath;
+                {
+                    lock_guard<mutex> locker(m_watchMtx);
+                    auto it = m_watchDirs.find(ev->wd);
+                    if (it == m_watchDirs.end()) { continue; }
+                    dir = it->second;
+                    if (ev->mask & IN_IGNORED) { m_watchDirs.erase(it); }
+                    if (ev->wd == m_packWd && ev->len && m_packName == ev->name) { packPath = m_packPath; }
+                }
+                if (!packPath.empty() && (ev->mask & IN_MOVED_TO)) {
+                    /* 只认rename进来的新包（新inode）；新包校验失败时继续使用旧包 */
+                    if (!loadPack(packPath)) {
+                        LOG_ERROR("Reload asset pack %s failed, keep serving the old one", packPath.c_str());
+                    }
+                    continue;
+                }
+                if (!packPath.empty() && (ev->mask & IN_CLOSE_WRITE)) {
+                    /* 原地改写会截断正在映射的inode，读到截断处的进程收到SIGBUS，只能提示 */
+                    LOG_ERROR("Asset pack %s was rewritten in place, replace it by rename instead", packPath.c_str());
+                    continue;
+                }
+                if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                    /* 整个目录被删除或移走 */
+                    clear();
+                    continue;
+                }
+                if (ev->len == 0) { continue; }
+                string path = dir + "/" + ev->name;
+                if (ev->mask & IN_ISDIR) {
+                    if (ev->mask & (IN_CREATE | IN_MOVED_TO)) { m_watchDir(path); }
+                    /* 目录移入移出后其下的路径都可能变化 */
+                    clear();
+                    continue;
+                }
+                invalidate(path);
+            }
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <fcntl.h>         // open
+#include <unistd.h>        // close
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>      // stat
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <time.h>
+
+#include "../log/log.h"
+#include "shardedlru.h"
+
+class AssetPack;
+
+/*
+ * 一个静态文件的元数据与内容：小文件读入内存（不随文件被原地修改而变化），
+ * 大文件保持fd打开供sendfile使用；资源包模式下data直接指向包的映射
+ */
+struct FileEntry {
+    FileEntry(): exists(false), watched(false), data(nullptr), fd(-1), st(), stale(false) {}
+    ~FileEntry() {
+        if (!pack) { delete[] data; }
+        if (fd >= 0) { close(fd); }
+    }
+
+    bool exists;        /* 文件不存在也缓存，避免404每次stat */
+    bool watched;       /* 在inotify监听范围内，文件变化时会被置为stale */
+    char* data;
+    int fd;
+    struct stat st;
+    std::string etag;           /* 强校验器，由inode、大小与修改时间生成，含引号 */
+    std::string lastModified;   /* HTTP-date */
+    mutable std::atomic<bool> stale;  /* 文件已变化（被淘汰不算），依赖本条目的派生缓存据此失效 */
+    std::shared_ptr<const AssetPack> pack;  /* data所在的资源包，条目存活期间映射不会被解除 */
+};
+
+/*
+ * 进程内共享的静态文件缓存，按路径分片加锁，每片独立LRU
+ * 条目以shared_ptr引用计数，被淘汰或失效后正在发送的响应仍可安全使用
+ * 监听线程通过inotify在资源目录下的文件变化时使对应条目失效，即时压缩由后台的压缩线程完成
+ * 命中时不产生任何文件系统调用
+ */
+class FileCache {
+    public:
+        enum ENCODING {
+            IDENTITY = 0,
+            GZIP,
+            BROTLI,
+            ENCODING_COUNT,
+        };
+
+        static FileCache* getInstance();
+
+        /* root下的文件才会被缓存；inotify不可用时不缓存，每次都重新加载 */
+        void init(const std::string& root, size_t maxBytes = 64 * 1024 * 1024,
+                  size_t maxEntries = 4096, size_t shardNum = 16);
+
+        /*
+         * 切换到资源包模式，之后只从包中取文件，包外的路径一律不存在
+         * 包文件被替换（rename到原路径）后自动重新加载，正在发送的响应仍使用旧包
+         * 包以MAP_PRIVATE映射，原地改写（cp覆盖、截断）会使读到变化部分的线程收到SIGBUS，不会触发重新加载
+         */
+        bool loadPack(const std::string& packPath);
+        bool packed() const { return m_packed; }
+
+        std::shared_ptr<const FileEntry> get(const std::string& rawPath);
+
+        /*
+         * 取文件的压缩版本：优先使用不旧于原文件的 .gz/.br 预压缩文件，否则交给压缩线程压缩后缓存（只对监听范围内的文件）
+         * 没有可用的压缩版本（压缩尚未完成，或压缩后不更小）时返回的条目exists为false，调用方先发送原文件
+         */
+        std::shared_ptr<const FileEntry> getEncoded(const std::string& rawPath,
+                        const std::shared_ptr<const FileEntry>& src, ENCODING encoding);
+
+        static const char* encodingName(ENCODING encoding);
+
+        /* 压缩成功且结果比原内容小时返回true */
+        static bool compress(const char* data, size_t len, ENCODING encoding, std::string& out);
+
+        void invalidate(const std::string& rawPath);
+        void clear();
+        size_t size() { return m_lru.size(); }
+        uint64_t hits() const { return m_lru.hits(); }
+        uint64_t misses() const { return m_lru.misses(); }
+        uint64_t evictions() const { return m_lru.evictions(); }
+        uint64_t compressions() const { return m_compressions.load(std::memory_order_relaxed); }
+
+        /* 不小于该大小的普通文件不读入内存，保留fd由sendfile发送 */
+        static size_t sendfileThreshold;
+        /* 超过该大小的文件不做即时压缩 */
+        static size_t maxCompressSize;
+
+    private:
+        FileCache();
+        ~FileCache();
+
+        static std::string m_normalize(const std::string& path);
+        bool m_cacheable(const std::string& path) const;
+        void m_watchDir(const std::string& dir);
+        void m_watchLoop();
+        void m_compressLoop();
+
+        static std::shared_ptr<FileEntry> m_load(const std::string& path);
+        static std::shared_ptr<FileEntry> m_loadPacked(const std::shared_ptr<const AssetPack>& pack,
+                        const std::string& key, ENCODING encoding);
+        static void m_setValidators(FileEntry& entry);
+        static std::shared_ptr<FileEntry> m_compress(const FileEntry& src, ENCODING encoding);
+        static bool m_readAll(const FileEntry& src, std::string& out);
+        static std::string m_encodedKey(const std::string& path, ENCODING encoding) {
+            return path + "\n" + encodingName(encoding);
+        }
+        static std::string m_encodedEtag(const std::string& etag, ENCODING encoding) {
+            /* 不同编码是不同的表示，校验器加上编码后缀区分 */
+            return etag.substr(0, etag.size() - 1) + "-" + encodingName(encoding) + "\"";
+        }
+        static size_t m_cost(const FileEntry& entry);
+
+        std::string m_root;
+        ShardedLru<std::shared_ptr<const FileEntry>> m_lru;
+
+        bool m_isOpen;
+        int m_inotifyFd;
+        int m_wakeupFd;
+        std::mutex m_watchMtx;
+        std::unordered_map<int, std::string> m_watchDirs;  /* wd -> 目录路径 */
+        std::unique_ptr<std::thread> m_watchThread;
+
+        /* 待压缩的任务，同一个键同时只有一个在队列中或正在压缩 */
+        struct CompressTask {
+            std::string key;
+            std::shared_ptr<const FileEntry> src;
+            ENCODING encoding;
+            uint64_t gen;
+        };
+        static const size_t MAX_COMPRESS_TASKS = 1024;
+        std::mutex m_compressMtx;
+        std::condition_variable m_compressCond;
+        std::deque<CompressTask> m_compressTasks;
+        std::unordered_set<std::string> m_compressing;
+        bool m_compressStop;
+        std::atomic<uint64_t> m_compressions;
+        std::unique_ptr<std::thread> m_compressThread;
+
+        std::atomic<bool> m_packed;
+        std::string m_packPath;
+        int m_packWd;               /* 包文件所在目录的监听 */
+        std::string m_packName;
+        std::shared_ptr<const AssetPack> m_pack;  /* 以std::atomic_load/atomic_store整体替换 */
+};
+
+#endif  //FILE_CACHE_H
@@ -4,11 +4,26 @@ using namespace std;
 const char* HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
+size_t HttpConn::fileWindow = 256 * 1024;
+size_t HttpConn::maxFileInflight = 64 * 1024 * 1024;
+std::atomic<int> HttpConn::streamCount;
+size_t HttpConn::readHighWater = 128 * 1024;
+size_t HttpConn::readLowWater = 32 * 1024;
+size_t HttpConn::maxBufferedBytes = 256 * 1024 * 1024;
+std::atomic<size_t> HttpConn::totalBuffered;
+std::atomic<int> HttpConn::pausedCount;
 
 HttpConn::HttpConn() {
     m_fd = -1;
     m_addr = { 0 };
     m_isClose = true;
+    m_isKeepAlive = false;
+    m_streaming = false;
+    m_window = 0;
+    m_buffered = 0;
+    m_readPaused = false;
+    m_overHighWater = false;
+    m_respCnt = 0;
 };
 
 HttpConn::~HttpConn() {
@@ -21,8 +36,11 @@ void HttpConn::init(int connFd, const sockaddr_in& client_address) {
     userCount++;
     m_addr = client_address;
     m_fd = connFd;
-    m_writeBuff.retrieveAll();
+    m_window = 0;
+    m_finishWrite();
     m_readBuff.retrieveAll();
+    m_request.init();
+    m_isKeepAlive = false;
     m_isClose = false;
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", m_fd, getIP(), getPort(), (int)userCount);
 }
@@ -34,37 +52,129 @@ ssize_t HttpConn::read(int* saveErrno) {
         if (len <= 0) {
             break;
         }
+        m_updateBuffered();
+        if (m_readPaused) {
+            /* 超过水位，socket中剩下的数据留到恢复后再读 */
+            break;
+        }
     } while (isET);
     return len;
 }
 
+bool HttpConn::resumeRead() {
+    m_updateBuffered();
+    return !m_readPaused;
+}
+
+void HttpConn::m_updateBuffered() {
+    size_t buffered = m_readBuff.readableBytes() + m_writeBuff.readableBytes();
+    size_t total;
+    if (buffered >= m_buffered) {
+        total = totalBuffered.fetch_add(buffered - m_buffered, std::memory_order_relaxed) + (buffered - m_buffered);
+    } else {
+        total = totalBuffered.fetch_sub(m_buffered - buffered, std::memory_order_relaxed) - (m_buffered - buffered);
+    }
+    m_buffered = buffered;
+    bool paused;
+    if (!m_readPaused) {
+        paused = buffered >= readHighWater || total >= maxBufferedBytes;
+        m_overHighWater = buffered >= readHighWater;
+    } else {
+        /* 只因全局预算暂停的连接不看低水位：未收全的请求首部（最多64KB）读到更多数据前取不走 */
+        m_overHighWater = m_overHighWater || buffered >= readHighWater;
+        paused = total >= maxBufferedBytes / 4 * 3 || (m_overHighWater && buffered >= readLowWater);
+    }
+    if (paused != m_readPaused) {
+        m_readPaused = paused;
+        pausedCount += paused ? 1 : -1;
+        if (paused && total >= maxBufferedBytes) {
+            LOG_WARN("Buffered %zu bytes over budget %zu, pause reading client[%d]", total, maxBufferedBytes, m_fd);
+        } else {
+            LOG_DEBUG("Client[%d] %s reading, buffered %zu bytes", m_fd, paused ? "pause" : "resume", buffered);
+        }
+    }
+}
+
 ssize_t HttpConn::write(int* saveErrno) {
     ssize_t len = -1;
     do {
-        len = writev(m_fd, m_iov, m_iovCnt);
-        if (len <= 0) {
+        int fd;
+        off_t off;
+        size_t fileLen;
+        if (m_out.peekFile(fd, off, fileLen)) {
+            /* 已发送的部分由retrieve推进文件区间的起点，EAGAIN后下次从断点继续 */
+            m_updateWindow();
+            len = sendfile(m_fd, fd, &off, std::min(fileLen, m_window));
+        } else {
+            len = m_writeMem();
+        }
+        if (len < 0) {
             *saveErrno = errno;
             break;
         }
-        if (m_iov[0].iov_len + m_iov[1].iov_len  == 0) { break; }  /* 传输结束 */
-        else if (static_cast<size_t>(len) > m_iov[0].iov_len) {
-            m_iov[1].iov_base = (uint8_t*) m_iov[1].iov_base + (len - m_iov[0].iov_len);
-            m_iov[1].iov_len -= (len - m_iov[0].iov_len);
-            if (m_iov[0].iov_len) {
-                m_writeBuff.retrieveAll();
-                m_iov[0].iov_len = 0;
-            }
-        } else {
-            m_iov[0].iov_base = (uint8_t*)m_iov[0].iov_base + len;
-            m_iov[0].iov_len -= len;
-            m_writeBuff.retrieve(len);
+        if (len == 0) {
+            /* 还有数据待发却没有进展：文件在发送中途被截断，errno是之前残留的值，按错误关闭 */
+            LOG_WARN("Client[%d] write made no progress with %zu bytes pending", m_fd, toWriteBytes());
+            *saveErrno = EIO;
+            break;
+        }
+        m_out.retrieve(len);
+        if (m_out.empty()) {
+            /* 传输结束 */
+            m_finishWrite();
+            break;
         }
     } while (isET || toWriteBytes() > 10240);
     return len;
 }
 
+ssize_t HttpConn::m_writeMem() {
+    /* 把连续的内存段合并为一次发送；其后还有文件段时带上MSG_MORE，让响应头与文件开头合并成满的报文段 */
+    struct iovec iov[MAX_IOV];
+    bool more;
+    struct msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = m_out.peekIov(iov, MAX_IOV, &more);
+    return sendmsg(m_fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+}
+
+void HttpConn::m_updateWindow() {
+    /* 取2的幂，发送大文件的连接数小幅变化时不必每次重设socket选项 */
+    size_t share = maxFileInflight / std::max(streamCount.load(std::memory_order_relaxed), 1);
+    size_t window = MIN_FILE_WINDOW;
+    while (window * 2 <= std::min(share, fileWindow)) {
+        window *= 2;
+    }
+    if (window != m_window) {
+        int lowat = static_cast<int>(window);
+        setsockopt(m_fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat));
+        m_window = window;
+    }
+}
+
+void HttpConn::m_finishWrite() {
+    if (m_streaming) {
+        streamCount--;
+        m_streaming = false;
+    }
+    m_out.clear();
+    m_writeBuff.retrieveAll();
+    for (size_t i = 0; i < m_respCnt; i++) {
+        m_responses[i]->unmapFile();
+    }
+    m_respCnt = 0;
+    m_updateBuffered();
+}
+
 void HttpConn::closeConn() {
-    m_response.unmapFile();
+    m_finishWrite();
+    m_readBuff.retrieveAll();
+    m_updateBuffered();
+    if (m_readPaused) {
+        m_readPaused = false;
+        m_overHighWater = false;
+        pausedCount--;
+    }
     if (m_isClose == false) {
         m_isClose = true;
         userCount--;
@@ -89,29 +199,92 @@ int HttpConn::getPort() const {
     return m_addr.sin_port;
 }
 
+HttpResponse* HttpConn::m_nextResponse() {
+    if (m_respCnt == m_responses.size()) {
+        m_responses.emplace_back(new HttpResponse());
+    }
+    return m_responses[m_respCnt++].get();
+}
+
 bool HttpConn::process() {
-    m_request.init();
-    if (m_readBuff.readableBytes() <= 0) {
+    assert(m_out.empty());
+    /* 读缓冲区中所有完整的请求一次处理完，响应合并到同一组iovec */
+    m_hdrEnd.clear();
+    while (m_readBuff.readableBytes() > 0 && m_respCnt < MAX_PIPELINE) {
+        HttpRequest::HTTP_CODE ret = m_request.parse(m_readBuff);
+        if (ret == HttpRequest::NO_REQUEST) {
+            /* 请求尚不完整，保留解析进度继续等待数据 */
+            break;
+        }
+        HttpResponse* response = m_nextResponse();
+        std::string_view method = m_request.method();
+        if (ret == HttpRequest::GET_REQUEST && method != "GET" && method != "HEAD" && method != "POST") {
+            response->init(srcDir, m_request.path(), m_request.isKeepAlive(), 405);
+        } else if (ret == HttpRequest::GET_REQUEST) {
+            LOG_DEBUG("%s", m_request.path().c_str());
+            HttpResponse::RequestHeaders headers;
+            headers.acceptEncoding = m_request.getHeader(HttpRequest::HDR_ACCEPT_ENCODING);
+            if (method == "GET" || method == "HEAD") {
+                /* 条件请求只对安全方法生效 */
+                headers.ifNoneMatch = m_request.getHeader(HttpRequest::HDR_IF_NONE_MATCH);
+                headers.ifModifiedSince = m_request.getHeader(HttpRequest::HDR_IF_MODIFIED_SINCE);
+            }
+            if (method == "GET") {
+                headers.range = m_request.getHeader(HttpRequest::HDR_RANGE);
+                headers.ifRange = m_request.getHeader(HttpRequest::HDR_IF_RANGE);
+            }
+            response->init(srcDir, m_request.path(), m_request.isKeepAlive(), 200, headers);
+        } else if (ret == HttpRequest::PAYLOAD_TOO_LARGE) {
+            response->init(srcDir, m_request.path(), false, 413);
+        } else {
+            response->init(srcDir, m_request.path(), false, 400);
+        }
+        /* HEAD的响应不带报文体，否则长连接上后续响应的边界会错位 */
+        response->makeResponse(m_writeBuff, method == "HEAD");
+        m_hdrEnd.push_back(m_writeBuff.readableBytes());
+        m_isKeepAlive = (ret == HttpRequest::GET_REQUEST) && m_request.isKeepAlive();
+        if (!m_isKeepAlive) {
+            /* 连接将关闭，其后的请求不再处理 */
+            break;
+        }
+    }
+    if (m_readBuff.readableBytes() == 0) {
+        /* 读缓冲区已取完，把块还给池，空闲连接不占缓冲内存 */
+        m_readBuff.retrieveAll();
+    }
+    m_updateBuffered();
+    if (m_respCnt == 0) {
         return false;
-    } else if (m_request.parse(m_readBuff)) {
-        LOG_DEBUG("%s", m_request.path().c_str());
-        m_response.init(srcDir, m_request.path(), m_request.isKeepAlive(), 200);
-    } else {
-        m_response.init(srcDir, m_request.path(), false, 400);
     }
 
-    m_response.makeResponse(m_writeBuff);
-    /* 响应头 */
-    m_iov[0].iov_base = const_cast<char*>(m_writeBuff.peek());
-    m_iov[0].iov_len = m_writeBuff.readableBytes();
-    m_iovCnt = 1;
-
-    /* 响应文件 */
-    if (m_response.fileLen() > 0 && m_response.file()) {
-        m_iov[1].iov_base = m_response.file();
-        m_iov[1].iov_len = m_response.fileLen();
-        m_iovCnt = 2;
+    /* 写缓冲区在追加过程中可能搬移，全部响应头生成后再取地址 */
+    const char* base = m_writeBuff.peek();
+    size_t hdrBegin = 0;
+    auto addMem = [&](size_t end) {
+        /* 命中响应缓存时响应头为空 */
+        m_out.appendRef(base + hdrBegin, end - hdrBegin);
+        hdrBegin = end;
+    };
+    for (size_t i = 0; i < m_respCnt; i++) {
+        /* 报文体各段（多区间时与各部分的头交替）：大文件走sendfile，小文件直接发送缓存中的内容 */
+        HttpResponse* response = m_responses[i].get();
+        for (const HttpResponse::Part& part: response->parts()) {
+            addMem(part.headEnd);
+            if (part.len == 0) {
+                continue;
+            }
+            if (response->fileFd() >= 0) {
+                m_out.appendFile(response->fileFd(), part.off, part.len);
+                m_streaming = true;
+            } else {
+                m_out.appendRef(response->file() + part.off, part.len);
+            }
+        }
+        addMem(m_hdrEnd[i]);
+    }
+    if (m_streaming) {
+        streamCount++;
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", m_response.fileLen(), m_iovCnt, toWriteBytes());
+    LOG_DEBUG("responses:%d, segments:%d, to write %d", (int)m_respCnt, (int)m_out.segmentCount(), (int)m_out.readableBytes());
     return true;
-}
\ No newline at end of file
+}
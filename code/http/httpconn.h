@@ -3,13 +3,19 @@
 
 #include <sys/types.h>
 #include <sys/uio.h>     // readv/writev
+#include <sys/socket.h>  // sendmsg
+#include <sys/sendfile.h>  // sendfile
 #include <arpa/inet.h>   // sockaddr_in
+#include <netinet/tcp.h> // TCP_NOTSENT_LOWAT
 #include <stdlib.h>      // atoi()
 #include <errno.h>
+#include <vector>
+#include <memory>
 
 #include "../log/log.h"
 #include "../pool/sqlconnRAII.h"
 #include "../buffer/buffer.h"
+#include "../buffer/chainbuffer.h"
 #include "httprequest.h"
 #include "httpresponse.h"
 
@@ -31,32 +37,83 @@ class HttpConn {
         sockaddr_in getAddr() const;
 
         bool process();
-        int toWriteBytes() {
-            return m_iov[0].iov_len + m_iov[1].iov_len;
+        size_t toWriteBytes() const {
+            return m_out.readableBytes();
         }
         bool isKeepAlive() const {
-            return m_request.isKeepAlive();
+            return m_isKeepAlive;
         }
+        bool isClose() const {
+            return m_isClose;
+        }
+        /* 读写缓冲区中的字节数 */
+        size_t bufferedBytes() const {
+            return m_buffered;
+        }
+        bool isReadPaused() const {
+            return m_readPaused;
+        }
+        /* 暂停读取的连接回落到低水位以下（且全局未超预算）时返回true */
+        bool resumeRead();
 
         static bool isET;
         static const char* srcDir;
         static std::atomic<int> userCount;
 
+        static const size_t MAX_PIPELINE = 32;  /* 一次处理的流水线请求上限 */
+        static const size_t MAX_IOV = 64;       /* 一次sendmsg的段数上限，其余段下次发送 */
+
+        /*
+         * 大文件按窗口发送：每次sendfile最多一个窗口，socket中未发出的数据也限制在一个窗口内（TCP_NOTSENT_LOWAT），
+         * 所有正在发送大文件的连接平分maxFileInflight，窗口在[MIN_FILE_WINDOW, fileWindow]之间
+         */
+        static size_t fileWindow;
+        static size_t maxFileInflight;
+        static std::atomic<int> streamCount;
+        static const size_t MIN_FILE_WINDOW = 16 * 1024;
+
+        /*
+         * 读背压：连接的缓冲字节数超过readHighWater，或所有连接合计超过maxBufferedBytes时停止读取（不再注册EPOLLIN），
+         * 回落到maxBufferedBytes的3/4以下后恢复，超过高水位的连接还要回落到readLowWater以下；
+         * readHighWater应大于请求首部上限（64KB），否则首部尚未收全的请求会一直等不到数据
+         */
+        static size_t readHighWater;
+        static size_t readLowWater;
+        static size_t maxBufferedBytes;
+        static std::atomic<size_t> totalBuffered;
+        static std::atomic<int> pausedCount;
+
     private:
+        HttpResponse* m_nextResponse();
+        ssize_t m_writeMem();
+        void m_finishWrite();
+        void m_updateWindow();
+        void m_updateBuffered();
 
         int m_fd;
         struct sockaddr_in m_addr;
 
         bool m_isClose;
-
-        int m_iovCnt;
-        struct iovec m_iov[2];
+        bool m_isKeepAlive;
+
+        /*
+         * 一批流水线请求的响应按顺序排成 [头部1][文件1][头部2][文件2]...，相邻的内存段一次sendmsg发出
+         * 头部引用m_writeBuff，小文件引用缓存中的内容，大文件为sendfile的文件区间，都不拷贝
+         */
+        ChainBuffer m_out;
+        bool m_streaming;   /* 本批有文件段，计入streamCount */
+        size_t m_window;    /* 当前窗口，0表示socket未设置过 */
+        size_t m_buffered;  /* 已计入totalBuffered的字节数 */
+        bool m_readPaused;
+        bool m_overHighWater;   /* 暂停期间本连接曾超过readHighWater */
 
         Buffer m_readBuff;  // 读缓冲区
-        Buffer m_writeBuff;  // 写缓冲区
+        Buffer m_writeBuff;  // 写缓冲区，存放所有响应头
 
         HttpRequest m_request;
-        HttpResponse m_response;
+        std::vector<std::unique_ptr<HttpResponse>> m_responses;
+        size_t m_respCnt;  /* 本批使用中的响应数 */
+        std::vector<size_t> m_hdrEnd;  /* 本批各响应在m_writeBuff中的结束位置，跨批复用 */
 };
 
 
@@ -0,0 +1,29 @@
+#include "httpdate.h"
+
+using namespace std;
+
+std::atomic<time_t> HttpDate::m_now(0);
+
+void HttpDate::tick() {
+    m_now.store(time(nullptr), memory_order_relaxed);
+}
+
+time_t HttpDate::now() {
+    time_t t = m_now.load(memory_order_relaxed);
+    return t ? t : time(nullptr);
+}
+
+string_view HttpDate::header() {
+    /* 每个线程各自缓存，不需要加锁 */
+    thread_local time_t cached = -1;
+    thread_local char buf[64];
+    thread_local size_t len = 0;
+    time_t t = now();
+    if (t != cached) {
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        len = strftime(buf, sizeof(buf), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        cached = t;
+    }
+    return string_view(buf, len);
+}
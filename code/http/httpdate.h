@@ -0,0 +1,26 @@
+#ifndef HTTP_DATE_H
+#define HTTP_DATE_H
+
+#include <atomic>
+#include <string_view>
+#include <time.h>
+
+/*
+ * 响应的Date首部：Reactor每轮事件循环调用tick()记下当前秒，
+ * 各线程在秒数变化时才重新格式化一次，生成响应时只取现成的首部行
+ */
+class HttpDate {
+    public:
+        static void tick();
+
+        /* "Date: <IMF-fixdate>\r\n" */
+        static std::string_view header();
+
+        /* 秒数；尚无Reactor调用tick()时（如测试中）直接取系统时间 */
+        static time_t now();
+
+    private:
+        static std::atomic<time_t> m_now;
+};
+
+#endif  //HTTP_DATE_H
@@ -9,45 +9,160 @@ const unordered_set<string> HttpRequest::DEFAULT_HTML {
 const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG {
             {"/register.html", 0}, {"/login.html", 1}, };
 
+size_t HttpRequest::maxBodySize = 1024 * 1024;
+
+/* 按HEADER_ID排列 */
+static constexpr std::string_view HEADER_NAME[HttpRequest::HDR_COUNT] = {
+            "", "Host", "Connection", "Content-Length", "Content-Type", "Transfer-Encoding",
+            "Accept-Encoding", "If-None-Match", "If-Modified-Since", "Range", "If-Range", };
+
+static constexpr char lowerAscii(char ch) {
+    return (ch >= 'A' && ch <= 'Z') ? ch - 'A' + 'a' : ch;
+}
+
+/* 由长度与首尾字符组成的哈希，对上面的常用首部恰好无冲突 */
+static constexpr size_t HEADER_HASH_SIZE = 32;
+static constexpr size_t headerHash(std::string_view name) {
+    return (name.size() + lowerAscii(name.front()) + lowerAscii(name.back())) & (HEADER_HASH_SIZE - 1);
+}
+
+struct HeaderSlots {
+    uint8_t id[HEADER_HASH_SIZE];
+    bool perfect;
+};
+
+static constexpr HeaderSlots makeHeaderSlots() {
+    HeaderSlots slots = {};
+    slots.perfect = true;
+    for (size_t i = 1; i < HttpRequest::HDR_COUNT; i++) {
+        size_t h = headerHash(HEADER_NAME[i]);
+        if (slots.id[h] != HttpRequest::HDR_OTHER) { slots.perfect = false; }
+        slots.id[h] = static_cast<uint8_t>(i);
+    }
+    return slots;
+}
+
+static constexpr HeaderSlots HEADER_SLOTS = makeHeaderSlots();
+static_assert(HEADER_SLOTS.perfect, "header hash collision, adjust headerHash");
+
 void HttpRequest::init() {
-    m_method = m_path = m_version = m_body = "";
+    m_path = m_body = "";
     m_state = REQUEST_LINE;
-    m_header.clear();
+    m_base = nullptr;
+    m_scanPos = 0;
+    m_bodyRemain = 0;
+    m_bodySize = 0;
+    m_method = m_version = { 0, 0 };
+    m_isKeepAlive = false;
+    m_spillHeader.clear();
+    m_headerCnt = 0;
+    memset(m_known, 0, sizeof(m_known));
     m_post.clear();
 }
 
-bool HttpRequest::parse(Buffer& buff) {
-    const char CRLF[] = "\r\n";
-    if (buff.readableBytes() <= 0) {
-        return false;
+HttpRequest::HTTP_CODE HttpRequest::parse(Buffer& buff) {
+    if (m_state == FINISH) {
+        /* 上一个请求已处理完，开始解析新请求 */
+        init();
     }
-    while (buff.readableBytes() && m_state != FINISH) {
-        const char* lineEnd = search(buff.peek(), buff.beginWriteConst(), CRLF, CRLF + 2);
-        std::string line(buff.peek(), lineEnd);
+    /*
+     * 请求行与首部不从缓冲区取走，整个请求完整后一次性retrieve，断点用偏移记录；
+     * 报文体及chunk分帧数据收到即移入body()，并从缓冲区中删除，缓冲区只保留首部
+     */
+    m_base = buff.peek();
+
+    while (m_state != FINISH) {
+        size_t readable = buff.readableBytes();
+        if (m_state == BODY || m_state == CHUNK_DATA) {
+            size_t len = std::min(readable - m_scanPos, m_bodyRemain);
+            if (len > 0) {
+                m_parseBody(buff, len);
+            }
+            m_bodyRemain -= len;
+            if (m_bodyRemain > 0) {
+                return NO_REQUEST;
+            }
+            m_state = (m_state == BODY) ? FINISH : CHUNK_CRLF;
+            continue;
+        }
+        /* 逐行扫描，行尾以LF为准，前面的CR可省略（RFC 9112 2.2） */
+        const char* begin = m_base + m_scanPos;
+        const char* lineEnd = static_cast<const char*>(memchr(begin, '\n', buff.beginWriteConst() - begin));
+        if (!lineEnd) {
+            if (readable > MAX_REQUEST_HEAD) {
+                LOG_ERROR("Request head too large");
+                m_isKeepAlive = false;
+                return BAD_REQUEST;
+            }
+            return NO_REQUEST;
+        }
+        const char* end = lineEnd;
+        if (end > begin && *(end - 1) == '\r') { end--; }
+        size_t lineLen = lineEnd + 1 - begin;
+
+        bool ok = true;
         switch (m_state) {
             case REQUEST_LINE:
-                if (!m_parseRequestLine(line)) {
-                    return false;
+                m_scanPos += lineLen;
+                if (begin == end) {
+                    /* 请求行之前的空行忽略 */
+                    break;
                 }
-                m_parsePath();
+                ok = m_parseRequestLine(begin, end);
+                if (ok) { m_parsePath(); }
                 break;
             case HEADERS:
-                m_parseHeader(line);
-                if (buff.readableBytes() <= 2) {
-                    m_state = FINISH;
+                m_scanPos += lineLen;
+                if (begin == end) {
+                    /* 空行：首部结束 */
+                    HTTP_CODE ret = m_parseHeadEnd();
+                    if (ret != NO_REQUEST) {
+                        m_isKeepAlive = false;
+                        return ret;
+                    }
+                    break;
+                }
+                ok = m_parseHeader(begin, end);
+                break;
+            case CHUNK_SIZE: {
+                HTTP_CODE ret = m_parseChunkSize(begin, end);
+                if (ret != NO_REQUEST) {
+                    m_isKeepAlive = false;
+                    return ret;
                 }
+                m_consume(buff, lineLen);
                 break;
-            case BODY:
-                m_parseBody(line);
+            }
+            case CHUNK_CRLF:
+                ok = (begin == end);
+                m_state = CHUNK_SIZE;
+                m_consume(buff, lineLen);
+                break;
+            case TRAILERS:
+                /* trailer字段不合并到首部，校验后丢弃 */
+                if (begin == end) {
+                    m_state = FINISH;
+                } else {
+                    const char* colon = begin;
+                    while (colon < end && isTchar(*colon)) { colon++; }
+                    ok = (colon != begin && colon != end && *colon == ':');
+                }
+                m_consume(buff, lineLen);
                 break;
             default:
                 break;
         }
-        if (lineEnd == buff.beginWrite()) { break; }
-        buff.retrieveUntil(lineEnd + 2);
+        if (!ok) {
+            LOG_ERROR("Request Error");
+            m_isKeepAlive = false;
+            return BAD_REQUEST;
+        }
     }
-    LOG_DEBUG("[%s], [%s], [%s]", m_method.c_str(), m_path.c_str(), m_version.c_str());
-    return true;
+    m_parsePost();
+    buff.retrieve(m_scanPos);
+    LOG_DEBUG("[%.*s], [%s], [%.*s]", (int)m_method.len, m_base + m_method.off, m_path.c_str(),
+                                      (int)m_version.len, m_base + m_version.off);
+    return GET_REQUEST;
 }
 
 std::string HttpRequest::path() const {
@@ -57,12 +172,45 @@ std::string HttpRequest::path() const {
 std::string& HttpRequest::path() {
     return m_path;
 }
-std::string HttpRequest::method() const {
-    return m_method;
+
+std::string_view HttpRequest::method() const {
+    return m_view(m_method);
+}
+
+std::string_view HttpRequest::version() const {
+    return m_view(m_version);
 }
 
-std::string HttpRequest::version() const {
-    return m_version;
+std::string_view HttpRequest::getHeader(HEADER_ID id) const {
+    assert(id > HDR_OTHER && id < HDR_COUNT);
+    if (m_known[id] == 0) {
+        return std::string_view();
+    }
+    return m_view(m_field(m_known[id] - 1).value);
+}
+
+std::string_view HttpRequest::getHeader(std::string_view name) const {
+    HEADER_ID id = headerId(name);
+    if (id != HDR_OTHER) {
+        return getHeader(id);
+    }
+    /* 字段名不区分大小写 */
+    for (size_t i = 0; i < m_headerCnt; i++) {
+        const Field& field = m_field(i);
+        if (field.id == HDR_OTHER && iequals(m_view(field.name), name)) {
+            return m_view(field.value);
+        }
+    }
+    return std::string_view();
+}
+
+HttpRequest::HEADER_ID HttpRequest::headerId(std::string_view name) {
+    if (name.empty()) { return HDR_OTHER; }
+    HEADER_ID id = static_cast<HEADER_ID>(HEADER_SLOTS.id[headerHash(name)]);
+    if (id != HDR_OTHER && iequals(name, HEADER_NAME[id])) {
+        return id;
+    }
+    return HDR_OTHER;
 }
 
 std::string HttpRequest::getPost(const std::string& key) const {
@@ -82,41 +230,159 @@ std::string HttpRequest::getPost(const char* key) const {
 }
 
 bool HttpRequest::isKeepAlive() const {
-    if (m_header.count("Connection") == 1) {
-        return m_header.find("Connection")->second == "keep-alive" && m_version == "1.1";
+    return m_isKeepAlive;
+}
+
+bool HttpRequest::m_parseRequestLine(const char* begin, const char* end) {
+    /* request-line = method SP request-target SP HTTP-version */
+    const char* p = begin;
+    while (p < end && isTchar(*p)) { p++; }
+    if (p == begin || p == end || *p != ' ') {
+        LOG_ERROR("RequestLine Error");
+        return false;
     }
-    return false;
+    m_method = m_span(begin, p);
+
+    const char* target = ++p;
+    while (p < end && static_cast<unsigned char>(*p) > 0x20 && *p != 0x7f) { p++; }
+    if (p == target || p == end || *p != ' ') {
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    m_path.assign(target, p - target);
+
+    /* HTTP-version = "HTTP/" DIGIT "." DIGIT */
+    p++;
+    if (end - p != 8 || memcmp(p, "HTTP/", 5) != 0 || !isdigit(p[5]) || p[6] != '.' || !isdigit(p[7])) {
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    m_version = m_span(p + 5, p + 8);
+    m_state = HEADERS;
+    return true;
 }
 
-bool HttpRequest::m_parseRequestLine(const string& line) {
-    regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    smatch subMatch;
-    if (regex_match(line, subMatch, patten)) {
-        m_method = subMatch[1];
-        m_path = subMatch[2];
-        m_version = subMatch[3];
-        m_state = HEADERS;
-        return true;
-    }
-    LOG_ERROR("RequestLine Error");
-    return false;
+HttpRequest::HTTP_CODE HttpRequest::m_parseHeadEnd() {
+    m_parseKeepAlive();
+    if (version() == "1.1" && getHeader(HDR_HOST).data() == nullptr) {
+        /* HTTP/1.1 请求必须带 Host（RFC 9112 3.2） */
+        LOG_ERROR("Header Error: missing Host");
+        return BAD_REQUEST;
+    }
+    /* 报文体长度由 Transfer-Encoding 或 Content-Length 决定，都没有则没有报文体（RFC 9112 6.3） */
+    std::string_view te = getHeader(HDR_TRANSFER_ENCODING);
+    std::string_view len = getHeader(HDR_CONTENT_LENGTH);
+    if (te.data() != nullptr) {
+        /* 两者同时出现可能是请求走私，直接拒绝；只支持单独的chunked编码 */
+        if (len.data() != nullptr || !iequals(te, "chunked")) {
+            LOG_ERROR("Header Error: bad Transfer-Encoding");
+            return BAD_REQUEST;
+        }
+        m_state = CHUNK_SIZE;
+        return NO_REQUEST;
+    }
+    if (len.data() != nullptr) {
+        if (len.empty() || len.size() > 18 || len.find_first_not_of("0123456789") != std::string_view::npos) {
+            LOG_ERROR("Header Error: bad Content-Length");
+            return BAD_REQUEST;
+        }
+        m_bodyRemain = strtoull(std::string(len).c_str(), nullptr, 10);
+        if (m_bodyRemain > maxBodySize) {
+            /* 在接收报文体之前就拒绝 */
+            LOG_WARN("Body too large: %zu", m_bodyRemain);
+            return PAYLOAD_TOO_LARGE;
+        }
+    }
+    m_state = (m_bodyRemain > 0) ? BODY : FINISH;
+    return NO_REQUEST;
 }
 
-void HttpRequest::m_parseHeader(const string& line) {
-    regex patten("^([^:]*): ?(.*)$");
-    smatch subMatch;
-    if (regex_match(line, subMatch, patten)) {
-        m_header[subMatch[1]] = subMatch[2];
+HttpRequest::HTTP_CODE HttpRequest::m_parseChunkSize(const char* begin, const char* end) {
+    /* chunk-size = 1*HEXDIG，其后的chunk-ext忽略 */
+    const char* p = begin;
+    size_t size = 0;
+    while (p < end && isxdigit(static_cast<unsigned char>(*p))) {
+        size = size * 16 + converHex(*p);
+        if (size > maxBodySize) {
+            /* 同时防止溢出 */
+            break;
+        }
+        p++;
+    }
+    if (m_bodySize + size > maxBodySize) {
+        LOG_WARN("Body too large: %zu", m_bodySize + size);
+        return PAYLOAD_TOO_LARGE;
+    }
+    if (p == begin || (p < end && *p != ';' && *p != ' ' && *p != '\t')) {
+        LOG_ERROR("Chunk Error");
+        return BAD_REQUEST;
+    }
+    m_bodyRemain = size;
+    m_state = (size > 0) ? CHUNK_DATA : TRAILERS;
+    return NO_REQUEST;
+}
+
+bool HttpRequest::m_parseHeader(const char* begin, const char* end) {
+    /* field-line = field-name ":" OWS field-value OWS，字段名与冒号之间不允许空白，拒绝obs-fold */
+    const char* p = begin;
+    while (p < end && isTchar(*p)) { p++; }
+    if (p == begin || p == end || *p != ':' || m_headerCnt >= MAX_HEADERS) {
+        LOG_ERROR("Header Error");
+        return false;
+    }
+    std::string_view name(begin, p - begin);
+    p++;
+    while (p < end && (*p == ' ' || *p == '\t')) { p++; }
+    const char* valueEnd = end;
+    while (valueEnd > p && (*(valueEnd - 1) == ' ' || *(valueEnd - 1) == '\t')) { valueEnd--; }
+    for (const char* q = p; q < valueEnd; q++) {
+        unsigned char ch = static_cast<unsigned char>(*q);
+        if ((ch < 0x20 && ch != '\t') || ch == 0x7f) {
+            LOG_ERROR("Header Error");
+            return false;
+        }
+    }
+    HEADER_ID id = headerId(name);
+    if (m_known[id] != 0 && (id == HDR_HOST || id == HDR_CONTENT_LENGTH || id == HDR_TRANSFER_ENCODING)) {
+        LOG_ERROR("Header Error: duplicate %.*s", (int)name.size(), name.data());
+        return false;
+    }
+    Field field = { m_span(begin, begin + name.size()), m_span(p, valueEnd), id };
+    if (m_headerCnt < INLINE_HEADERS) {
+        m_inlineHeader[m_headerCnt] = field;
     } else {
-        m_state = BODY;
+        m_spillHeader.push_back(field);
+    }
+    m_headerCnt++;
+    if (id != HDR_OTHER && m_known[id] == 0) {
+        m_known[id] = static_cast<uint16_t>(m_headerCnt);
     }
+    return true;
 }
 
-void HttpRequest::m_parseBody(const string& line) {
-    m_body = line;
-    m_parsePost();
-    m_state = FINISH;
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+void HttpRequest::m_parseBody(Buffer& buff, size_t len) {
+    /* 报文体整个保存在body()中，大小受maxBodySize限制 */
+    m_body.append(m_base + m_scanPos, len);
+    m_bodySize += len;
+    m_consume(buff, len);
+    LOG_DEBUG("Body:%zu bytes, total:%zu", len, m_bodySize);
+}
+
+void HttpRequest::m_consume(Buffer& buff, size_t len) {
+    /* 删除首部之后已处理的len字节，首部偏移不受影响 */
+    buff.erase(m_base + m_scanPos, len);
+}
+
+void HttpRequest::m_parseKeepAlive() {
+    /* HTTP/1.1 默认长连接，除非 Connection 中含 close；HTTP/1.0 需显式 keep-alive（RFC 9112 9.3） */
+    std::string_view conn = getHeader(HDR_CONNECTION);
+    if (hasToken(conn, "close")) {
+        m_isKeepAlive = false;
+    } else if (version() == "1.1") {
+        m_isKeepAlive = true;
+    } else {
+        m_isKeepAlive = hasToken(conn, "keep-alive");
+    }
 }
 
 void HttpRequest::m_parsePath() {
@@ -133,7 +399,7 @@ void HttpRequest::m_parsePath() {
 }
 
 void HttpRequest::m_parsePost() {
-    if (m_method == "POST" && m_header["Content-Type"] == "application/x-www-form-urlencoded") {
+    if (method() == "POST" && getHeader(HDR_CONTENT_TYPE) == "application/x-www-form-urlencoded") {
         m_parseFromUrlencoded();
         if (DEFAULT_HTML_TAG.count(m_path)) {
             int tag = DEFAULT_HTML_TAG.find(m_path)->second;
@@ -192,11 +458,48 @@ void HttpRequest::m_parseFromUrlencoded() {
 }
 
 int HttpRequest::converHex(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
     if (ch >= 'A' && ch <= 'F') return ch -'A' + 10;
     if (ch >= 'a' && ch <= 'f') return ch -'a' + 10;
     return ch;
 }
 
+bool HttpRequest::isTchar(char ch) {
+    /* tchar = "!" / "#" / "$" / "%" / "&" / "'" / "*" / "+" / "-" / "." / "^" / "_" / "`" / "|" / "~" / DIGIT / ALPHA */
+    if (isalnum(static_cast<unsigned char>(ch))) { return true; }
+    switch (ch) {
+        case '!': case '#': case '$': case '%': case '&': case '\'': case '*': case '+':
+        case '-': case '.': case '^': case '_': case '`': case '|': case '~':
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool HttpRequest::iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) { return false; }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HttpRequest::hasToken(std::string_view list, std::string_view token) {
+    /* 在逗号分隔的列表中查找token，如 "Connection: keep-alive, Upgrade" */
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) { item.remove_prefix(1); }
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) { item.remove_suffix(1); }
+        if (iequals(item, token)) { return true; }
+        if (comma == std::string_view::npos) { break; }
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
 bool HttpRequest::userVerify(const string &name, const string &pwd, bool isLogin) {
     if (name == "" || pwd == "") { return false; }
     LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
@@ -4,7 +4,8 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <vector>
 #include <errno.h>
 #include <mysql/mysql.h>
 
@@ -18,7 +19,11 @@ class HttpRequest {
         enum PARSE_STATE {
             REQUEST_LINE,
             HEADERS,
-            BODY,
+            BODY,           /* Content-Length 报文体 */
+            CHUNK_SIZE,     /* chunked：chunk-size [chunk-ext] CRLF */
+            CHUNK_DATA,
+            CHUNK_CRLF,     /* chunk-data 之后的 CRLF */
+            TRAILERS,       /* last-chunk 之后的 trailer 字段直到空行 */
             FINISH,
         };
 
@@ -31,22 +36,49 @@ class HttpRequest {
             FILE_REQUEST,
             INTERNAL_ERROR,
             CLOSED_CONNECTION,
+            PAYLOAD_TOO_LARGE,
+        };
+
+        /* 常用首部在解析时映射为ID，按ID取值无需字符串比较 */
+        enum HEADER_ID {
+            HDR_OTHER = 0,
+            HDR_HOST,
+            HDR_CONNECTION,
+            HDR_CONTENT_LENGTH,
+            HDR_CONTENT_TYPE,
+            HDR_TRANSFER_ENCODING,
+            HDR_ACCEPT_ENCODING,
+            HDR_IF_NONE_MATCH,
+            HDR_IF_MODIFIED_SINCE,
+            HDR_RANGE,
+            HDR_IF_RANGE,
+            HDR_COUNT,
         };
 
         HttpRequest() { init(); }
         ~HttpRequest() = default;
 
         void init();
-        bool parse(Buffer& buff);
+        /* 可重入：数据不完整时返回NO_REQUEST并保留解析进度，下次读入更多数据后从断点继续 */
+        HTTP_CODE parse(Buffer& buff);
 
         std::string path() const;
         std::string& path();
-        std::string method() const;
-        std::string version() const;
+        std::string_view method() const;
+        std::string_view version() const;
+        std::string_view getHeader(HEADER_ID id) const;
+        std::string_view getHeader(std::string_view name) const;
         std::string getPost(const std::string& key) const;
         std::string getPost(const char* key) const;
+        const std::string& body() const { return m_body; }
 
         bool isKeepAlive() const;
+        bool isFinish() const { return m_state == FINISH; }
+
+        static size_t maxBodySize;  /* 报文体上限，超出返回413 */
+
+        /* 字段名（不区分大小写）到ID的完美哈希，非常用首部返回HDR_OTHER */
+        static HEADER_ID headerId(std::string_view name);
 
         /* 
         todo 
@@ -55,9 +87,35 @@ class HttpRequest {
         */
 
     private:
-        bool m_parseRequestLine(const std::string& line);
-        void m_parseHeader(const std::string& line);
-        void m_parseBody(const std::string& line);
+        /* 相对于请求起点（读缓冲区peek()）的偏移，缓冲区扩容或搬移后依然有效 */
+        struct Span {
+            uint32_t off;
+            uint32_t len;
+        };
+
+        struct Field {
+            Span name;
+            Span value;
+            HEADER_ID id;
+        };
+
+        std::string_view m_view(Span span) const {
+            return std::string_view(m_base + span.off, span.len);
+        }
+        Span m_span(const char* begin, const char* end) const {
+            return { static_cast<uint32_t>(begin - m_base), static_cast<uint32_t>(end - begin) };
+        }
+
+        bool m_parseRequestLine(const char* begin, const char* end);
+        bool m_parseHeader(const char* begin, const char* end);
+        HTTP_CODE m_parseHeadEnd();
+        HTTP_CODE m_parseChunkSize(const char* begin, const char* end);
+        void m_parseBody(Buffer& buff, size_t len);
+        void m_consume(Buffer& buff, size_t len);
+        const Field& m_field(size_t i) const {
+            return i < INLINE_HEADERS ? m_inlineHeader[i] : m_spillHeader[i - INLINE_HEADERS];
+        }
+        void m_parseKeepAlive();
 
         void m_parsePath();
         void m_parsePost();
@@ -65,14 +123,35 @@ class HttpRequest {
 
         static bool userVerify(const std::string& name, const std::string& pwd, bool isLogin);
 
+        /*
+         * method/version/header 只记录在读缓冲区中的偏移，不做拷贝，
+         * 返回的string_view只在本次请求处理期间（下一次向该缓冲区读入数据之前）有效
+         */
         PARSE_STATE m_state;
-        std::string m_method, m_path, m_version, m_body;
-        std::unordered_map<std::string, std::string> m_header;
+        const char* m_base;     /* 本次请求报文的起点 */
+        size_t m_scanPos;       /* 已解析到的位置（相对m_base） */
+        size_t m_bodyRemain;    /* 当前Content-Length报文体或chunk剩余的字节数 */
+        size_t m_bodySize;      /* 已接收的报文体总长 */
+        Span m_method, m_version;
+        std::string m_path, m_body;
+        /* 首部表：前INLINE_HEADERS个存放在对象内，超出部分才放入vector，vector容量随连接复用 */
+        static const size_t INLINE_HEADERS = 16;
+        Field m_inlineHeader[INLINE_HEADERS];
+        std::vector<Field> m_spillHeader;
+        size_t m_headerCnt;
+        uint16_t m_known[HDR_COUNT];  /* 常用首部第一次出现的下标+1，0表示没有 */
         std::unordered_map<std::string, std::string> m_post;
+        bool m_isKeepAlive;
+
+        static const size_t MAX_HEADERS = 100;
+        static const size_t MAX_REQUEST_HEAD = 64 * 1024;  /* 请求行+首部的上限 */
 
         static const std::unordered_set<std::string> DEFAULT_HTML;
         static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
         static int converHex(char ch);
+        static bool isTchar(char ch);
+        static bool iequals(std::string_view a, std::string_view b);
+        static bool hasToken(std::string_view list, std::string_view token);
 };
 
 
@@ -2,171 +2,696 @@
 
 using namespace std;
 
-const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
-    { ".html",  "text/html" },
-    { ".xml",   "text/xml" },
-    { ".xhtml", "application/xhtml+xml" },
-    { ".txt",   "text/plain" },
-    { ".rtf",   "application/rtf" },
-    { ".pdf",   "application/pdf" },
-    { ".word",  "application/msword" },
-    { ".png",   "image/png" },
-    { ".gif",   "image/gif" },
-    { ".jpg",   "image/jpeg" },
-    { ".jpeg",  "image/jpeg" },
-    { ".au",    "audio/basic" },
-    { ".mpeg",  "video/mpeg" },
-    { ".mpg",   "video/mpeg" },
-    { ".avi",   "video/x-msvideo" },
-    { ".gz",    "application/x-gzip" },
-    { ".tar",   "application/x-tar" },
-    { ".css",   "text/css" },
-    { ".js",    "text/javascript" },
+/*
+ * 按后缀的类型与缓存策略，首部行在编译期拼好，按后缀的完美哈希查找，不分配内存
+ * 页面每次向服务器确认（命中时为304），静态资源允许浏览器直接使用；只压缩文本类内容
+ */
+struct MimeType {
+    string_view suffix;         /* 不含'.' */
+    string_view type;
+    string_view header;         /* "Content-type: ...\r\n" */
+    string_view cacheControl;   /* "Cache-Control: ...\r\n" */
+    bool compressible;
 };
 
-const unordered_map<int, string> HttpResponse::CODE_STATUS = {
-    { 200, "OK" },
-    { 400, "Bad Request" },
-    { 403, "Forbidden" },
-    { 404, "Not Found" },
-    { 500, "Internal Error" },
+#define MIME(suffix, type, cache, compressible) \
+    { suffix, type, "Content-type: " type "\r\n", "Cache-Control: " cache "\r\n", compressible }
+#define PAGE        "no-cache"
+#define ASSET       "public, max-age=86400"
+#define MEDIA       "public, max-age=604800"
+
+static constexpr MimeType MIME_TYPE[] = {
+    MIME("",      "text/plain",                 PAGE,  false),  /* 未知后缀 */
+    MIME("html",  "text/html",                  PAGE,  true),
+    MIME("htm",   "text/html",                  PAGE,  true),
+    MIME("xml",   "text/xml",                   PAGE,  true),
+    MIME("xhtml", "application/xhtml+xml",      PAGE,  true),
+    MIME("txt",   "text/plain",                 PAGE,  true),
+    MIME("rtf",   "application/rtf",            ASSET, true),
+    MIME("pdf",   "application/pdf",            ASSET, false),
+    MIME("word",  "application/msword",         ASSET, false),
+    MIME("png",   "image/png",                  MEDIA, false),
+    MIME("gif",   "image/gif",                  MEDIA, false),
+    MIME("jpg",   "image/jpeg",                 MEDIA, false),
+    MIME("jpeg",  "image/jpeg",                 MEDIA, false),
+    MIME("webp",  "image/webp",                 MEDIA, false),
+    MIME("ico",   "image/x-icon",               MEDIA, true),
+    MIME("svg",   "image/svg+xml",              MEDIA, true),
+    MIME("au",    "audio/basic",                MEDIA, false),
+    MIME("mp3",   "audio/mpeg",                 MEDIA, false),
+    MIME("mpeg",  "video/mpeg",                 MEDIA, false),
+    MIME("mpg",   "video/mpeg",                 MEDIA, false),
+    MIME("avi",   "video/x-msvideo",            MEDIA, false),
+    MIME("mp4",   "video/mp4",                  MEDIA, false),
+    MIME("webm",  "video/webm",                 MEDIA, false),
+    MIME("gz",    "application/x-gzip",         ASSET, false),
+    MIME("tar",   "application/x-tar",          ASSET, false),
+    MIME("css",   "text/css",                   ASSET, true),
+    MIME("js",    "text/javascript",            ASSET, true),
+    MIME("mjs",   "text/javascript",            ASSET, true),
+    MIME("json",  "application/json",           ASSET, true),
+    MIME("map",   "application/json",           ASSET, true),
+    MIME("wasm",  "application/wasm",           ASSET, true),
+    MIME("woff",  "font/woff",                  MEDIA, false),
+    MIME("woff2", "font/woff2",                 MEDIA, false),
+    MIME("otf",   "font/otf",                   MEDIA, true),
+    MIME("ttf",   "font/ttf",                   MEDIA, true),
+    MIME("eot",   "application/vnd.ms-fontobject", MEDIA, true),
+};
+
+#undef MIME
+#undef PAGE
+#undef ASSET
+#undef MEDIA
+
+static constexpr size_t MIME_COUNT = sizeof(MIME_TYPE) / sizeof(MIME_TYPE[0]);
+
+static constexpr char lowerAscii(char ch) {
+    return (ch >= 'A' && ch <= 'Z') ? ch - 'A' + 'a' : ch;
+}
+
+/* 后缀长度与首、次、末字符的组合，对上表无冲突（由static_assert保证） */
+static constexpr size_t MIME_HASH_SIZE = 128;
+static constexpr size_t mimeHash(string_view suffix) {
+    return (suffix.size() + 5 * lowerAscii(suffix[0]) + 5 * lowerAscii(suffix[suffix.size() > 1])
+            + 2 * lowerAscii(suffix.back())) & (MIME_HASH_SIZE - 1);
+}
+
+struct MimeSlots {
+    uint8_t idx[MIME_HASH_SIZE];    /* MIME_TYPE下标，0表示空 */
+    bool perfect;
+};
+
+static constexpr MimeSlots makeMimeSlots() {
+    MimeSlots slots = {};
+    slots.perfect = MIME_COUNT < 256;
+    for (size_t i = 1; i < MIME_COUNT; i++) {
+        size_t h = mimeHash(MIME_TYPE[i].suffix);
+        if (slots.idx[h] != 0) { slots.perfect = false; }
+        slots.idx[h] = static_cast<uint8_t>(i);
+    }
+    return slots;
+}
+
+static constexpr MimeSlots MIME_SLOTS = makeMimeSlots();
+static_assert(MIME_SLOTS.perfect, "mime hash collision, adjust mimeHash");
+
+/*
+ * 状态码直接索引，错误页路径与响应头模板同样在编译期生成
+ * 模板按长连接与否各一份：状态行、Server与Connection，之后只需追加随请求变化的首部
+ */
+struct HttpStatus {
+    int code;
+    string_view reason;
+    string_view page;           /* 错误页，空表示没有 */
+    string_view keepAlive;      /* 长连接的首部模板 */
+    string_view close;
 };
 
-const unordered_map<int, string> HttpResponse::CODE_PATH = {
-    { 400, "/400.html" },
-    { 403, "/403.html" },
-    { 404, "/404.html" },
-    { 500, "/500.html" },
+#define STATUS_HEAD(code, reason) "HTTP/1.1 " #code " " reason "\r\nServer: WebServer\r\n"
+#define STATUS(code, reason, page) { code, reason, page, \
+    STATUS_HEAD(code, reason) "Connection: keep-alive\r\nkeep-alive: max=5 timeout=120\r\n", \
+    STATUS_HEAD(code, reason) "Connection: close\r\n" }
+
+static constexpr HttpStatus HTTP_STATUS[] = {
+    STATUS(400, "Bad Request", "/400.html"),     /* 未知状态码按400处理 */
+    STATUS(200, "OK", ""),
+    STATUS(206, "Partial Content", ""),
+    STATUS(304, "Not Modified", ""),
+    STATUS(403, "Forbidden", "/403.html"),
+    STATUS(404, "Not Found", "/404.html"),
+    STATUS(405, "Method Not Allowed", "/405.html"),
+    STATUS(413, "Payload Too Large", "/413.html"),
+    STATUS(416, "Range Not Satisfiable", ""),
+    STATUS(500, "Internal Server Error", "/error.html"),
+};
+
+#undef STATUS
+#undef STATUS_HEAD
+
+static constexpr size_t STATUS_COUNT = sizeof(HTTP_STATUS) / sizeof(HTTP_STATUS[0]);
+static constexpr int MAX_STATUS = 600;
+
+struct StatusSlots {
+    uint8_t idx[MAX_STATUS];        /* HTTP_STATUS下标，0为400 */
 };
 
+static constexpr StatusSlots makeStatusSlots() {
+    StatusSlots slots = {};
+    for (size_t i = 1; i < STATUS_COUNT; i++) {
+        slots.idx[HTTP_STATUS[i].code] = static_cast<uint8_t>(i);
+    }
+    return slots;
+}
+
+static constexpr StatusSlots STATUS_SLOTS = makeStatusSlots();
+
+static size_t statusIndex(int code) {
+    return (code >= 0 && code < MAX_STATUS) ? STATUS_SLOTS.idx[code] : 0;
+}
+
+static const HttpStatus& httpStatus(int code) {
+    return HTTP_STATUS[statusIndex(code)];
+}
+
+/*
+ * 启动时按错误页生成的完整响应，下标为 HTTP_STATUS下标 * 2 + 是否长连接，生成后只读
+ * 与缓存的响应一样，发送时插入当前的Date
+ */
+static vector<shared_ptr<const RenderedResponse>> errorPages;
+
+/* 不经过to_string，直接把十进制写进缓冲区 */
+static void appendUint(Buffer& buff, uint64_t val) {
+    char buf[20];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    do {
+        *--p = '0' + val % 10;
+        val /= 10;
+    } while (val);
+    buff.append(p, end - p);
+}
+
+static const MimeType& mimeType(const string& path) {
+    size_t dot = path.find_last_of("./");
+    if (dot == string::npos || path[dot] != '.' || dot + 1 == path.size()) {
+        return MIME_TYPE[0];
+    }
+    string_view suffix(path.data() + dot + 1, path.size() - dot - 1);
+    const MimeType& mime = MIME_TYPE[MIME_SLOTS.idx[mimeHash(suffix)]];
+    if (mime.suffix.size() != suffix.size()) {
+        return MIME_TYPE[0];
+    }
+    for (size_t i = 0; i < suffix.size(); i++) {
+        if (lowerAscii(suffix[i]) != mime.suffix[i]) {
+            return MIME_TYPE[0];
+        }
+    }
+    return mime;
+}
+
+/* multipart/byteranges 的分隔符，进程启动时随机生成 */
+const string HttpResponse::BOUNDARY = [] {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)std::random_device()() << 32 ^ std::random_device()());
+    return string("ws-byteranges-") + buf;
+}();
+
 HttpResponse::HttpResponse() {
     m_code = -1;
     m_isKeepAlive = false;
+    m_isHead = false;
+    m_acceptEncoding = 0;
+    m_vary = false;
+    m_encoding = FileCache::IDENTITY;
     m_path = m_srcDir = "";
-    m_mmFile = nullptr;
-    m_mmFileStat = { 0 };
 };
 
 HttpResponse::~HttpResponse() {
     unmapFile();
 }
 
-void HttpResponse::init(const string& srcDir, string& path, bool isKeepAlive, int code) {
+void HttpResponse::init(const string& srcDir, string& path, bool isKeepAlive, int code,
+                        const RequestHeaders& headers) {
     assert(srcDir != "");
-    if (m_mmFile) { unmapFile(); }
+    unmapFile();
     m_code = code;
     m_isKeepAlive = isKeepAlive;
+    m_headers = headers;
+    m_acceptEncoding = parseAcceptEncoding(headers.acceptEncoding);
+    m_vary = false;
+    m_encoding = FileCache::IDENTITY;
+    m_ranges.clear();
+    m_parts.clear();
     m_path = path;
     m_srcDir = srcDir;
-    m_mmFile = nullptr;
-    m_mmFileStat = { 0 };
 }
 
-void HttpResponse::makeResponse(Buffer& buff) {
-    /* 判断请求的资源文件 */
-    if (stat((m_srcDir + m_path).data(), &m_mmFileStat) < 0 || S_ISDIR(m_mmFileStat.st_mode)) {
-        m_code = 404;
-    } else if (!(m_mmFileStat.st_mode & S_IROTH)) {
-        m_code = 403;
-    } else if(m_code == -1) {
-        m_code = 200;
+void HttpResponse::makeResponse(Buffer& buff, bool isHead) {
+    m_isHead = isHead;
+    /* 判断请求的资源文件，调用方已给出错误码时直接返回对应错误页 */
+    if (m_code < 400) {
+        m_file = FileCache::getInstance()->get(m_srcDir + m_path);
+        if (!m_file->exists || S_ISDIR(m_file->st.st_mode)) {
+            m_code = 404;
+        } else if (!(m_file->st.st_mode & S_IROTH)) {
+            m_code = 403;
+        } else if(m_code == -1) {
+            m_code = 200;
+        }
+    }
+    if (m_code == 200) {
+        m_negotiate();
+        if (m_notModified()) {
+            m_code = 304;
+        } else if (m_headers.range.data()) {
+            m_code = m_parseRange();
+        }
+    }
+    if (m_code >= 400 && !errorPages.empty()) {
+        m_rendered = errorPages[statusIndex(m_code) * 2 + m_isKeepAlive];
+    }
+    if (m_code == 200 && m_file->data && m_file->watched
+            && m_file->st.st_size < static_cast<off_t>(FileCache::sendfileThreshold)) {
+        /*
+         * 常驻内存且变化可感知的小文件整条响应可缓存，每秒变化的Date不进入缓存，发送时插在首部模板之后
+         * 资源包中的大文件同样常驻（映射），但整条复制代价太大，直接引用映射发送
+         */
+        m_renderCached();
+    }
+    if (m_rendered) {
+        m_file.reset();
+        size_t dateOff = m_rendered->dateOff;
+        m_parts.assign(1, { buff.readableBytes(), 0, dateOff });
+        buff.append(HttpDate::header());
+        size_t end = m_isHead ? m_rendered->bodyOff : m_rendered->data.size();
+        m_parts.push_back({ buff.readableBytes(), static_cast<off_t>(dateOff), end - dateOff });
+        return;
     }
     m_errorHtml();
     m_addStateLine(buff);
+    buff.append(HttpDate::header());
     m_addHeader(buff);
     m_addContent(buff);
 }
 
-void HttpResponse::unmapFile() {
-    if (m_mmFile) {
-        munmap(m_mmFile, m_mmFileStat.st_size);
-        m_mmFile = nullptr;
+void HttpResponse::loadErrorPages(const string& srcDir) {
+    vector<shared_ptr<const RenderedResponse>> pages(STATUS_COUNT * 2);
+    for (size_t i = 0; i < STATUS_COUNT; i++) {
+        if (HTTP_STATUS[i].page.empty()) {
+            continue;
+        }
+        /* 错误页文件读不到时使用内置的错误内容 */
+        HttpResponse response;
+        response.m_code = HTTP_STATUS[i].code;
+        response.m_path = string(HTTP_STATUS[i].page);
+        /* 经文件缓存读取，资源包模式下错误页同样来自包 */
+        Buffer body;
+        shared_ptr<const FileEntry> file = FileCache::getInstance()->get(srcDir + response.m_path);
+        if (file->data) {
+            body.append(file->data, file->st.st_size);
+        } else if (file->fd >= 0) {
+            char buf[4096];
+            ssize_t len;
+            for (off_t off = 0; (len = pread(file->fd, buf, sizeof(buf), off)) > 0; off += len) {
+                body.append(buf, len);
+            }
+        }
+        for (int keepAlive = 0; keepAlive < 2; keepAlive++) {
+            response.m_isKeepAlive = keepAlive;
+            Buffer head(256);
+            response.m_addStateLine(head);
+            size_t dateOff = head.readableBytes();
+            response.m_addHeader(head);
+            if (body.readableBytes() > 0) {
+                head.append("Content-length: ");
+                appendUint(head, body.readableBytes());
+                head.append("\r\n\r\n");
+                head.append(body);
+            } else {
+                response.errorContent(head, "File NotFound!");
+            }
+            shared_ptr<RenderedResponse> page = make_shared<RenderedResponse>();
+            page->data.assign(head.peek(), head.readableBytes());
+            page->dateOff = dateOff;
+            page->bodyOff = page->data.find("\r\n\r\n", dateOff) + 4;
+            pages[i * 2 + keepAlive] = page;
+        }
+        LOG_INFO("Error page %d: %s", HTTP_STATUS[i].code, response.m_path.c_str());
     }
+    errorPages.swap(pages);
 }
 
-char* HttpResponse::file() {
-    return m_mmFile;
+void HttpResponse::m_renderCached() {
+    ResponseCache* cache = ResponseCache::getInstance();
+    uint64_t gen;
+    if (cache->get(m_path, m_isKeepAlive, m_encoding, m_file, m_rendered, gen)) {
+        return;
+    }
+    Buffer head(256);
+    m_addStateLine(head);
+    size_t dateOff = head.readableBytes();
+    m_addHeader(head);
+    m_addContent(head);
+    shared_ptr<RenderedResponse> rendered = make_shared<RenderedResponse>();
+    rendered->file = m_file;
+    rendered->dateOff = dateOff;
+    rendered->bodyOff = head.readableBytes();
+    rendered->data.reserve(head.readableBytes() + m_file->st.st_size);
+    rendered->data.append(head.peek(), head.readableBytes());
+    rendered->data.append(m_file->data, m_file->st.st_size);
+    cache->put(m_path, m_isKeepAlive, m_encoding, rendered, gen);
+    m_rendered = rendered;
 }
 
-size_t HttpResponse::fileLen() const {
-    return m_mmFileStat.st_size;
+void HttpResponse::m_negotiate() {
+    /* 只压缩文本类内容，图片、音视频等本身已压缩 */
+    if (!mimeType(m_path).compressible) {
+        return;
+    }
+    m_vary = true;
+    if (m_headers.range.data()) {
+        /* 区间按原始内容计算，带Range的请求不压缩 */
+        return;
+    }
+    static const FileCache::ENCODING PREFERENCE[] = { FileCache::BROTLI, FileCache::GZIP };
+    for (FileCache::ENCODING enc: PREFERENCE) {
+        if (!(m_acceptEncoding & (1 << enc))) {
+            continue;
+        }
+        shared_ptr<const FileEntry> encoded = FileCache::getInstance()->getEncoded(m_srcDir + m_path, m_file, enc);
+        if (encoded->exists) {
+            m_file = encoded;
+            m_encoding = enc;
+            return;
+        }
+    }
 }
 
-void HttpResponse::errorContent(Buffer& buff, string message) {
-    string body;
-    string status;
-    body += "<html><title>Error</title>";
-    body += "<body bgcolor=\"ffffff\">";
-    if (CODE_STATUS.count(m_code) == 1) {
-        status = CODE_STATUS.find(m_code)->second;
-    } else {
-        status = "Bad Request";
+bool HttpResponse::m_notModified() const {
+    /* 同时出现时忽略If-Modified-Since（RFC 9110 13.2.2） */
+    if (m_headers.ifNoneMatch.data()) {
+        return m_matchEtag(m_headers.ifNoneMatch, m_file->etag);
+    }
+    if (!m_headers.ifModifiedSince.data() || m_file->lastModified.empty()) {
+        return false;
+    }
+    /* 浏览器通常原样带回Last-Modified，相同时不必解析日期 */
+    if (m_headers.ifModifiedSince == m_file->lastModified) {
+        return true;
+    }
+    string date(m_headers.ifModifiedSince);
+    struct tm tm = {};
+    const char* end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end || *end != '\0') {
+        return false;
     }
-    body += to_string(m_code) + " : " + status  + "\n";
-    body += "<p>" + message + "</p>";
-    body += "<hr><em>WebServer</em></body></html>";
+    return m_file->st.st_mtime <= timegm(&tm);
+}
 
-    buff.append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
-    buff.append(body);
+static bool parseOffset(string_view s, off_t& val) {
+    if (s.empty() || s.size() > 18 || s.find_first_not_of("0123456789") != string_view::npos) {
+        return false;
+    }
+    val = 0;
+    for (char ch: s) {
+        val = val * 10 + (ch - '0');
+    }
+    return true;
 }
 
-void HttpResponse::m_addStateLine(Buffer& buff) {
-    string status;
-    if (CODE_STATUS.count(m_code) == 1) {
-        status = CODE_STATUS.find(m_code)->second;
-    } else {
-        m_code = 400;
-        status = CODE_STATUS.find(400)->second;
+static string_view trimOws(string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) { s.remove_prefix(1); }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) { s.remove_suffix(1); }
+    return s;
+}
+
+static bool iequals(string_view a, const char* b) {
+    return a.size() == strlen(b) && strncasecmp(a.data(), b, a.size()) == 0;
+}
+
+bool HttpResponse::m_matchEtag(string_view list, const string& etag) {
+    /* 弱比较：忽略W/前缀 */
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        string_view tag = trimOws(list.substr(0, comma));
+        list = (comma == string_view::npos) ? string_view() : list.substr(comma + 1);
+        if (tag == "*") {
+            return true;
+        }
+        if (tag.size() > 2 && tag[0] == 'W' && tag[1] == '/') {
+            tag.remove_prefix(2);
+        }
+        if (!etag.empty() && tag == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int HttpResponse::m_parseRange() {
+    /* If-Range只认强ETag或与Last-Modified完全相同的日期，不匹配时发送完整内容 */
+    if (m_headers.ifRange.data()) {
+        string_view ifRange = trimOws(m_headers.ifRange);
+        if (ifRange != m_file->etag && ifRange != m_file->lastModified) {
+            return 200;
+        }
+    }
+    /* 语法错误或不认识的单位按没有Range处理 */
+    string_view spec = trimOws(m_headers.range);
+    if (spec.size() < 6 || strncasecmp(spec.data(), "bytes=", 6) != 0) {
+        return 200;
+    }
+    spec.remove_prefix(6);
+    const off_t size = m_file->st.st_size;
+    m_ranges.clear();
+    size_t count = 0;
+    while (!spec.empty()) {
+        size_t comma = spec.find(',');
+        string_view item = trimOws(spec.substr(0, comma));
+        spec = (comma == string_view::npos) ? string_view() : spec.substr(comma + 1);
+        if (item.empty()) {
+            continue;
+        }
+        size_t dash = item.find('-');
+        if (dash == string_view::npos || ++count > MAX_RANGES) {
+            m_ranges.clear();
+            return 200;
+        }
+        string_view a = item.substr(0, dash), b = item.substr(dash + 1);
+        off_t first, last;
+        if (a.empty()) {
+            /* 后缀区间：最后n个字节 */
+            if (!parseOffset(b, last)) {
+                m_ranges.clear();
+                return 200;
+            }
+            if (last == 0 || size == 0) { continue; }
+            first = last >= size ? 0 : size - last;
+            last = size - 1;
+        } else {
+            if (!parseOffset(a, first) || (!b.empty() && (!parseOffset(b, last) || last < first))) {
+                m_ranges.clear();
+                return 200;
+            }
+            if (first >= size) { continue; }
+            last = (b.empty() || last >= size) ? size - 1 : last;
+        }
+        m_ranges.push_back({ first, last });
+    }
+    if (m_ranges.empty()) {
+        return 416;
+    }
+    /* 重叠或相邻的区间合并，避免同一内容被重复发送 */
+    sort(m_ranges.begin(), m_ranges.end(), [](const ByteRange& x, const ByteRange& y) {
+        return x.first < y.first;
+    });
+    size_t n = 0;
+    for (size_t i = 1; i < m_ranges.size(); i++) {
+        if (m_ranges[i].first <= m_ranges[n].last + 1) {
+            m_ranges[n].last = max(m_ranges[n].last, m_ranges[i].last);
+        } else {
+            m_ranges[++n] = m_ranges[i];
+        }
+    }
+    m_ranges.resize(n + 1);
+    return 206;
+}
+
+int HttpResponse::parseAcceptEncoding(string_view value) {
+    const int ALL = (1 << FileCache::GZIP) | (1 << FileCache::BROTLI);
+    int accept = 0, reject = 0;
+    bool star = false;
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        string_view item = value.substr(0, comma);
+        value = (comma == string_view::npos) ? string_view() : value.substr(comma + 1);
+        size_t semi = item.find(';');
+        string_view coding = trimOws(item.substr(0, semi));
+        /* 只关心q是否为0：0、0.、0.000 */
+        bool zero = false;
+        if (semi != string_view::npos) {
+            string_view param = trimOws(item.substr(semi + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                string_view q = param.substr(2);
+                zero = (q[0] == '0' && q.find_first_not_of("0.", 1) == string_view::npos);
+            }
+        }
+        int bit = 0;
+        if (iequals(coding, "gzip") || iequals(coding, "x-gzip")) {
+            bit = 1 << FileCache::GZIP;
+        } else if (iequals(coding, "br")) {
+            bit = 1 << FileCache::BROTLI;
+        } else if (coding == "*") {
+            star = !zero;
+            continue;
+        }
+        if (zero) {
+            reject |= bit;
+        } else {
+            accept |= bit;
+        }
+    }
+    /* 未明确列出的编码由 * 决定 */
+    if (star) {
+        accept |= ALL & ~reject;
+    }
+    return accept & ~reject;
+}
+
+void HttpResponse::unmapFile() {
+    m_file.reset();
+    m_rendered.reset();
+}
+
+const char* HttpResponse::file() const {
+    if (m_rendered) {
+        return m_rendered->data.data();
     }
-    buff.append("HTTP/1.1 " + to_string(m_code) + " " + status + "\r\n");
+    return m_file ? m_file->data : nullptr;
+}
+
+size_t HttpResponse::fileLen() const {
+    if (m_rendered) {
+        return m_rendered->data.size();
+    }
+    return m_file ? m_file->st.st_size : 0;
+}
+
+void HttpResponse::errorContent(Buffer& buff, string_view message) {
+    /* 先算出长度，各段直接写入buff，不拼接临时字符串 */
+    static constexpr string_view HEAD = "<html><title>Error</title><body bgcolor=\"ffffff\">";
+    static constexpr string_view TAIL = "</p><hr><em>WebServer</em></body></html>";
+    string_view reason = httpStatus(m_code).reason;
+    size_t codeLen = 1;
+    for (int code = m_code; code >= 10; code /= 10) { codeLen++; }
+    size_t len = HEAD.size() + codeLen + 3 + reason.size() + 4 + message.size() + TAIL.size();
+    buff.append("Content-length: ");
+    appendUint(buff, len);
+    buff.append("\r\n\r\n");
+    if (m_isHead) {
+        return;
+    }
+    buff.append(HEAD);
+    appendUint(buff, m_code);
+    buff.append(" : ");
+    buff.append(reason);
+    buff.append("\n<p>");
+    buff.append(message);
+    buff.append(TAIL);
+}
+
+void HttpResponse::m_addStateLine(Buffer& buff) {
+    const HttpStatus& status = httpStatus(m_code);
+    m_code = status.code;
+    buff.append(m_isKeepAlive ? status.keepAlive : status.close);
 }
 
 void HttpResponse::m_addHeader(Buffer& buff) {
-    buff.append("Connection: ");
-    if (m_isKeepAlive) {
-        buff.append("keep-alive\r\n");
-        buff.append("keep-alive: max=5 timeout=120\r\n");
+    if (m_code == 206 && m_ranges.size() > 1) {
+        buff.append("Content-type: multipart/byteranges; boundary=" + BOUNDARY + "\r\n");
     } else {
-        buff.append("close\r\n");
+        buff.append(mimeType(m_path).header);
+    }
+    if (m_code == 405) {
+        buff.append("Allow: GET, HEAD, POST\r\n");
+    }
+    if ((m_code == 200 || m_code == 206) && m_encoding == FileCache::IDENTITY) {
+        buff.append("Accept-Ranges: bytes\r\n");
+    }
+    if (m_code == 200 || m_code == 206 || m_code == 304) {
+        buff.append("ETag: ");
+        buff.append(m_file->etag);
+        buff.append("\r\nLast-Modified: ");
+        buff.append(m_file->lastModified);
+        buff.append("\r\n");
+        buff.append(mimeType(m_path).cacheControl);
+    }
+    if ((m_code == 200 || m_code == 206 || m_code == 304) && m_vary) {
+        buff.append("Vary: Accept-Encoding\r\n");
+    }
+    if (m_code == 200 && m_encoding != FileCache::IDENTITY) {
+        buff.append("Content-Encoding: ");
+        buff.append(FileCache::encodingName(m_encoding));
+        buff.append("\r\n");
     }
-    buff.append("Content-type: " + m_getFileType() + "\r\n");
 }
 
 void HttpResponse::m_addContent(Buffer& buff) {
-    int srcFd = open((m_srcDir + m_path).data(), O_RDONLY);
-    if (srcFd < 0) { 
+    if (m_code == 304) {
+        /* 304没有报文体，不引用文件内容 */
+        buff.append("\r\n");
+        m_file.reset();
+        return;
+    }
+    if (m_code == 416) {
+        buff.append("Content-Range: bytes */");
+        appendUint(buff, m_file->st.st_size);
+        buff.append("\r\nContent-length: 0\r\n\r\n");
+        m_file.reset();
+        return;
+    }
+    if (!m_file || (!m_file->data && m_file->fd < 0)) {
         errorContent(buff, "File NotFound!");
-        return; 
+        return;
     }
-
-    /* 将文件映射到内存提高文件的访问速度, MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
     LOG_DEBUG("file path %s", (m_srcDir + m_path).data());
-    int* mmRet = (int*)mmap(0, m_mmFileStat.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if (*mmRet == -1) {
-        errorContent(buff, "File NotFound!");
-        return; 
+    if (m_code == 206 && m_ranges.size() > 1) {
+        m_addMultipart(buff);
+        return;
+    }
+    off_t off = 0;
+    size_t len = m_file->st.st_size;
+    if (m_code == 206) {
+        off = m_ranges[0].first;
+        len = m_ranges[0].last - off + 1;
+        buff.append("Content-Range: bytes ");
+        appendUint(buff, off);
+        buff.append("-");
+        appendUint(buff, m_ranges[0].last);
+        buff.append("/");
+        appendUint(buff, m_file->st.st_size);
+        buff.append("\r\n");
+    }
+    buff.append("Content-length: ");
+    appendUint(buff, len);
+    buff.append("\r\n\r\n");
+    if (!m_isHead) {
+        m_parts.push_back({ buff.readableBytes(), off, len });
     }
-    m_mmFile = (char*)mmRet;
-    close(srcFd);
-    buff.append("Content-length: " + to_string(m_mmFileStat.st_size) + "\r\n\r\n");
 }
 
-void HttpResponse::m_errorHtml() {
-    if (CODE_PATH.count(m_code) == 1) {
-        m_path = CODE_PATH.find(m_code)->second;
-        stat((m_srcDir + m_path).data(), &m_mmFileStat);
+void HttpResponse::m_addMultipart(Buffer& buff) {
+    /* 各部分的头先生成出来，才能算出Content-length */
+    string type(mimeType(m_path).type);
+    vector<string> heads;
+    size_t total = 0;
+    for (size_t i = 0; i < m_ranges.size(); i++) {
+        heads.push_back((i == 0 ? "--" : "\r\n--") + BOUNDARY + "\r\nContent-Type: " + type
+                        + "\r\nContent-Range: bytes " + to_string(m_ranges[i].first) + "-" + to_string(m_ranges[i].last)
+                        + "/" + to_string(m_file->st.st_size) + "\r\n\r\n");
+        total += heads[i].size() + (m_ranges[i].last - m_ranges[i].first + 1);
+    }
+    string tail = "\r\n--" + BOUNDARY + "--\r\n";
+    total += tail.size();
+    buff.append("Content-length: ");
+    appendUint(buff, total);
+    buff.append("\r\n\r\n");
+    if (m_isHead) {
+        return;
     }
+    for (size_t i = 0; i < m_ranges.size(); i++) {
+        buff.append(heads[i]);
+        m_parts.push_back({ buff.readableBytes(), m_ranges[i].first,
+                            static_cast<size_t>(m_ranges[i].last - m_ranges[i].first + 1) });
+    }
+    buff.append(tail);
 }
 
-string HttpResponse::m_getFileType() {
-    /* 判断文件类型 */
-    string::size_type idx = m_path.find_last_of('.');
-    if (idx == string::npos) {
-        return "text/plain";
-    }
-    string suffix = m_path.substr(idx);
-    if (SUFFIX_TYPE.count(suffix) == 1) {
-        return SUFFIX_TYPE.find(suffix)->second;
+void HttpResponse::m_errorHtml() {
+    string_view page = httpStatus(m_code).page;
+    if (!page.empty()) {
+        m_path = string(page);
+        m_file = FileCache::getInstance()->get(m_srcDir + m_path);
     }
-    return "text/plain";
 }
@@ -1,48 +1,99 @@
 #ifndef HTTP_RESPONSE_H
 #define HTTP_RESPONSE_H
 
-#include <unordered_map>
-#include <fcntl.h>       // open
-#include <unistd.h>      // close
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <string_view>
+#include <strings.h>     // strncasecmp
 #include <sys/stat.h>    // stat
-#include <sys/mman.h>    // mmap, munmap
 
 #include "../buffer/buffer.h"
 #include "../log/log.h"
+#include "filecache.h"
+#include "httpdate.h"
+#include "responsecache.h"
 
 class HttpResponse {
     public:
+        /* 影响响应的请求首部，指向读缓冲区，只在makeResponse返回前有效 */
+        struct RequestHeaders {
+            std::string_view acceptEncoding;
+            std::string_view ifNoneMatch;
+            std::string_view ifModifiedSince;
+            std::string_view range;
+            std::string_view ifRange;
+        };
+
+        /* 报文体的一段：写缓冲区中到headEnd为止的内容发出后，发送文件内容的[off, off+len) */
+        struct Part {
+            size_t headEnd;
+            off_t off;
+            size_t len;
+        };
+
         HttpResponse();
         ~HttpResponse();
 
-        void init(const std::string& srcDir, std::string& path, bool isKeepAlive = false, int code = -1);
-        void makeResponse(Buffer& buff);
+        void init(const std::string& srcDir, std::string& path, bool isKeepAlive = false, int code = -1,
+                  const RequestHeaders& headers = RequestHeaders());
+        /* HEAD请求的响应与GET的首部相同（含Content-length与ETag），不带报文体 */
+        void makeResponse(Buffer& buff, bool isHead = false);
+        /* 释放对缓存文件与缓存响应的引用 */
         void unmapFile();
-        char* file();
+        /* 报文体各段所引用的内容：文件内容或整个缓存的响应 */
+        const char* file() const;
+        int fileFd() const { return (m_file && !m_rendered) ? m_file->fd : -1; }
         size_t fileLen() const;
-        void errorContent(Buffer& buff, std::string message);
+        const std::vector<Part>& parts() const { return m_parts; }
+        void errorContent(Buffer& buff, std::string_view message);
         int code() const { return m_code; }
+        FileCache::ENCODING encoding() const { return m_encoding; }
+
+        /* 启动时调用一次：把各错误页读入内存并生成完整的响应，之后错误响应不再访问文件 */
+        static void loadErrorPages(const std::string& srcDir);
+
+        /* Accept-Encoding 解析为可接受编码的位掩码（1 << ENCODING），q=0 表示拒绝 */
+        static int parseAcceptEncoding(std::string_view value);
 
     private:
         void m_addStateLine(Buffer &buff);
         void m_addHeader(Buffer &buff);
         void m_addContent(Buffer &buff);
+        void m_renderCached();
+        void m_negotiate();
+        bool m_notModified() const;
+        static bool m_matchEtag(std::string_view list, const std::string& etag);
+        int m_parseRange();
+        void m_addMultipart(Buffer& buff);
 
         void m_errorHtml();
-        std::string m_getFileType();
 
         int m_code;
         bool m_isKeepAlive;
+        bool m_isHead;
+        RequestHeaders m_headers;
+        int m_acceptEncoding;
+        bool m_vary;                        /* 内容随Accept-Encoding变化 */
+        FileCache::ENCODING m_encoding;     /* 实际发送的编码，m_file指向对应编码的内容 */
 
         std::string m_path;
         std::string m_srcDir;
 
-        char* m_mmFile;
-        struct stat m_mmFileStat;
+        /* 文件的元数据与内容都来自FileCache，命中时不产生文件系统调用 */
+        std::shared_ptr<const FileEntry> m_file;
+        std::shared_ptr<const RenderedResponse> m_rendered;
+
+        struct ByteRange {
+            off_t first;
+            off_t last;     /* 含 */
+        };
+        std::vector<ByteRange> m_ranges;    /* 206时按升序排列且互不重叠 */
+        std::vector<Part> m_parts;
 
-        static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;
-        static const std::unordered_map<int, std::string> CODE_STATUS;
-        static const std::unordered_map<int, std::string> CODE_PATH;
+        static const size_t MAX_RANGES = 16;
+        static const std::string BOUNDARY;
 };
 
 
@@ -0,0 +1,47 @@
+#include "responsecache.h"
+
+using namespace std;
+
+ResponseCache* ResponseCache::getInstance() {
+    static ResponseCache responseCache;
+    return &responseCache;
+}
+
+void ResponseCache::init(size_t maxBytes, size_t maxEntries, size_t shardNum) {
+    if (!m_lru.empty()) { return; }
+    m_lru.init(shardNum, maxBytes, maxEntries);
+    LOG_INFO("Response cache: %zu shards, %zu MB", shardNum, maxBytes >> 20);
+}
+
+const string& ResponseCache::m_key(const string& path, bool isKeepAlive, FileCache::ENCODING encoding) {
+    thread_local string key;
+    key.assign(path);
+    key.append(isKeepAlive ? "\n1" : "\n0");
+    key.append(FileCache::encodingName(encoding));
+    return key;
+}
+
+bool ResponseCache::get(const string& path, bool isKeepAlive, FileCache::ENCODING encoding,
+                        const shared_ptr<const FileEntry>& file,
+                        shared_ptr<const RenderedResponse>& response, uint64_t& gen) {
+    if (m_lru.empty()) {
+        return false;
+    }
+    /*
+     * 与FileCache的当前条目比较而不是看stale：条目先被FileCache淘汰再失效时不会被标记，
+     * 比较指针可以同时覆盖这两种情况；响应持有旧条目，其地址不会被新条目复用
+     */
+    return m_lru.get(m_key(path, isKeepAlive, encoding), response, &gen, [&file](const shared_ptr<const RenderedResponse>& r) {
+        return r->file == file;
+    });
+}
+
+void ResponseCache::put(const string& path, bool isKeepAlive, FileCache::ENCODING encoding,
+                        const shared_ptr<const RenderedResponse>& response, uint64_t gen) {
+    if (m_lru.empty()) {
+        return;
+    }
+    /* 渲染所用的文件随本条目一起保留，计入开销 */
+    size_t cost = sizeof(RenderedResponse) + response->data.size() + response->file->st.st_size;
+    m_lru.put(m_key(path, isKeepAlive, encoding), response, cost, gen);
+}
@@ -0,0 +1,54 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <memory>
+#include <string>
+
+#include "filecache.h"
+#include "shardedlru.h"
+
+/* 序列化好的完整响应：状态行、首部与文件内容连续存放，与当前的Date首部一起一次writev发出 */
+struct RenderedResponse {
+    std::shared_ptr<const FileEntry> file;  /* 渲染所用的文件，不再是FileCache中的当前条目时本响应作废 */
+    std::string data;
+    size_t dateOff;     /* Date首部的插入位置（首部模板之后），Date不缓存 */
+    size_t bodyOff;     /* 报文体的起始位置，HEAD请求只发送到此为止 */
+};
+
+/*
+ * 小文件200响应的缓存，每个文件按长连接/短连接与内容编码各缓存一份，
+ * 命中时只增加引用计数，不再拼接首部
+ */
+class ResponseCache {
+    public:
+        static ResponseCache* getInstance();
+
+        void init(size_t maxBytes = 32 * 1024 * 1024, size_t maxEntries = 4096, size_t shardNum = 16);
+
+        /*
+         * 命中返回true；未命中时gen供put使用
+         * file为FileCache当前返回的条目，与渲染所用的不是同一个（文件已变化，或条目被淘汰后重新加载）时按未命中处理
+         */
+        bool get(const std::string& path, bool isKeepAlive, FileCache::ENCODING encoding,
+                 const std::shared_ptr<const FileEntry>& file,
+                 std::shared_ptr<const RenderedResponse>& response, uint64_t& gen);
+
+        void put(const std::string& path, bool isKeepAlive, FileCache::ENCODING encoding,
+                 const std::shared_ptr<const RenderedResponse>& response, uint64_t gen);
+
+        size_t size() { return m_lru.size(); }
+        uint64_t hits() const { return m_lru.hits(); }
+        uint64_t misses() const { return m_lru.misses(); }
+        uint64_t evictions() const { return m_lru.evictions(); }
+
+    private:
+        ResponseCache() = default;
+        ~ResponseCache() = default;
+
+        /* 拼在每个线程复用的缓冲区中，命中路径上不分配内存 */
+        static const std::string& m_key(const std::string& path, bool isKeepAlive, FileCache::ENCODING encoding);
+
+        ShardedLru<std::shared_ptr<const RenderedResponse>> m_lru;
+};
+
+#endif  //RESPONSE_CACHE_H
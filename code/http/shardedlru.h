@@ -0,0 +1,174 @@
+#ifndef SHARDED_LRU_H
+#define SHARDED_LRU_H
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <assert.h>
+
+/*
+ * 按key分片加锁的LRU表，每片独立淘汰，容量以字节与条目数两方面约束
+ * 每片有一个失效代数：未命中时记下代数，加载完成后放入时若期间发生过失效则丢弃，避免放入过期内容
+ */
+template<class V>
+class ShardedLru {
+    public:
+        ShardedLru(): m_maxBytes(0), m_maxEntries(0), m_hits(0), m_misses(0), m_evictions(0) {}
+
+        void init(size_t shardNum, size_t maxBytes, size_t maxEntries);
+
+        /*
+         * 命中返回true；未命中时gen中返回当前代数，供put使用
+         * valid对命中的条目做校验，不通过的条目删除并按未命中处理
+         */
+        bool get(const std::string& key, V& value, uint64_t* gen = nullptr,
+                 const std::function<bool(const V&)>& valid = nullptr);
+
+        void put(const std::string& key, const V& value, size_t cost, uint64_t gen);
+
+        /* 删除前对条目调用fn */
+        void erase(const std::string& key, const std::function<void(const V&)>& fn = nullptr);
+
+        /* 对所有条目调用fn后清空 */
+        void clear(const std::function<void(const V&)>& fn = nullptr);
+
+        size_t size();
+
+        bool empty() const { return m_shards.empty(); }
+
+        uint64_t hits() const { return m_hits.load(std::memory_order_relaxed); }
+        uint64_t misses() const { return m_misses.load(std::memory_order_relaxed); }
+        uint64_t evictions() const { return m_evictions.load(std::memory_order_relaxed); }
+
+    private:
+        struct Node {
+            std::string key;
+            V value;
+            size_t cost;
+        };
+
+        struct Shard {
+            std::mutex mtx;
+            std::list<Node> lru;  /* 表头为最近使用 */
+            std::unordered_map<std::string, typename std::list<Node>::iterator> index;
+            size_t bytes = 0;
+            uint64_t gen = 0;
+        };
+
+        Shard& m_shard(const std::string& key) {
+            return *m_shards[std::hash<std::string>()(key) % m_shards.size()];
+        }
+
+        size_t m_maxBytes;      /* 每片的上限 */
+        size_t m_maxEntries;
+        std::vector<std::unique_ptr<Shard>> m_shards;
+
+        std::atomic<uint64_t> m_hits;
+        std::atomic<uint64_t> m_misses;
+        std::atomic<uint64_t> m_evictions;
+};
+
+
+template<class V>
+void ShardedLru<V>::init(size_t shardNum, size_t maxBytes, size_t maxEntries) {
+    assert(shardNum > 0 && m_shards.empty());
+    m_maxBytes = maxBytes / shardNum;
+    m_maxEntries = maxEntries / shardNum + 1;
+    for (size_t i = 0; i < shardNum; i++) {
+        m_shards.emplace_back(new Shard);
+    }
+}
+
+template<class V>
+bool ShardedLru<V>::get(const std::string& key, V& value, uint64_t* gen,
+                        const std::function<bool(const V&)>& valid) {
+    Shard& shard = m_shard(key);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end() && valid && !valid(it->second->value)) {
+        shard.bytes -= it->second->cost;
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+        it = shard.index.end();
+    }
+    if (it == shard.index.end()) {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        if (gen) { *gen = shard.gen; }
+        return false;
+    }
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    value = it->second->value;
+    return true;
+}
+
+template<class V>
+void ShardedLru<V>::put(const std::string& key, const V& value, size_t cost, uint64_t gen) {
+    Shard& shard = m_shard(key);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    if (shard.gen != gen || cost > m_maxBytes) {
+        /* 超过一片上限的条目放入后淘汰不掉（至少保留一个），直接不缓存 */
+        return;
+    }
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        /* 并发未命中时重复加载，以后放入的为准 */
+        shard.bytes -= it->second->cost;
+        shard.lru.erase(it->second);
+    }
+    shard.lru.push_front({ key, value, cost });
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += cost;
+    while ((shard.bytes > m_maxBytes || shard.index.size() > m_maxEntries) && shard.lru.size() > 1) {
+        Node& victim = shard.lru.back();
+        shard.bytes -= victim.cost;
+        shard.index.erase(victim.key);
+        shard.lru.pop_back();
+        m_evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template<class V>
+void ShardedLru<V>::erase(const std::string& key, const std::function<void(const V&)>& fn) {
+    Shard& shard = m_shard(key);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    shard.gen++;
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        if (fn) { fn(it->second->value); }
+        shard.bytes -= it->second->cost;
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+}
+
+template<class V>
+void ShardedLru<V>::clear(const std::function<void(const V&)>& fn) {
+    for (auto& shard: m_shards) {
+        std::lock_guard<std::mutex> locker(shard->mtx);
+        shard->gen++;
+        if (fn) {
+            for (auto& node: shard->lru) { fn(node.value); }
+        }
+        shard->lru.clear();
+        shard->index.clear();
+        shard->bytes = 0;
+    }
+}
+
+template<class V>
+size_t ShardedLru<V>::size() {
+    size_t n = 0;
+    for (auto& shard: m_shards) {
+        std::lock_guard<std::mutex> locker(shard->mtx);
+        n += shard->index.size();
+    }
+    return n;
+}
+
+#endif  //SHARDED_LRU_H
@@ -115,6 +115,7 @@ void Log::write(int level, const char *format, ...) {
     {
         unique_lock<mutex> locker(m_mtx);
         m_lineCount++;
+        m_buff.ensureWriteable(128);
         int n = snprintf(m_buff.beginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
                     t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
                     t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
@@ -7,6 +7,11 @@ int main() {
     WebServer server(
         8088, 3, 5000, false,                       /* 网络端口 ET模式 timeoutMS 退出 */
         3306, "root", "admin+-*/", "webserver",     /* Mysql配置（根据自己系统上的数据库配置进行修改） */
-        12, 8, false, 0, 1024);                     /* 数据库连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        12, 8, false, 0, 1024,                      /* 数据库连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        WebServer::POOL_REACTOR, 4,                 /* Reactor模式（POOL_REACTOR: Reactor+线程池 REUSEPORT_REACTOR: 每线程一个SO_REUSEPORT监听的Reactor */
+                                                    /* MAIN_SUB_REACTOR: 主Reactor accept后投递给从Reactor） Reactor线程数 */
+        WebServer::ROUND_ROBIN,                     /* 主从模式的连接分发策略（ROUND_ROBIN 或 LEAST_CONN） */
+        Poller::EPOLL,                              /* IO多路复用后端（EPOLL 或 IO_URING，io_uring不可用时退回epoll） */
+        nullptr);                                   /* 资源包路径（由bin/mkpack生成，nullptr时直接读resources目录） */
     server.start();
 }
\ No newline at end of file
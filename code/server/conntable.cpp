@@ -0,0 +1,45 @@
+#include "conntable.h"
+
+ConnTable::ConnTable(size_t maxFd): m_slots(maxFd) {
+    assert(maxFd > 0);
+}
+
+size_t ConnTable::limitFd(size_t maxFd) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < maxFd) {
+        return rl.rlim_cur;
+    }
+    return maxFd;
+}
+
+uint64_t ConnTable::open(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= m_slots.size()) {
+        return 0;
+    }
+    Slot& slot = m_slots[fd];
+    if (!slot.conn) {
+        slot.conn.reset(new HttpConn());
+    }
+    uint32_t gen = slot.gen.load(std::memory_order_relaxed) + 1;
+    if (gen == 0) { gen = 1; }  /* 代数0保留给监听等非连接fd */
+    slot.gen.store(gen, std::memory_order_release);
+    return (static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(fd);
+}
+
+HttpConn* ConnTable::lookup(uint64_t key) const {
+    int fd = keyFd(key);
+    if (fd < 0 || static_cast<size_t>(fd) >= m_slots.size()) {
+        return nullptr;
+    }
+    const Slot& slot = m_slots[fd];
+    if (slot.gen.load(std::memory_order_acquire) != static_cast<uint32_t>(key >> 32)) {
+        return nullptr;
+    }
+    return slot.conn.get();
+}
+
+uint64_t ConnTable::key(int fd) const {
+    assert(fd >= 0 && static_cast<size_t>(fd) < m_slots.size());
+    uint32_t gen = m_slots[fd].gen.load(std::memory_order_acquire);
+    return (static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(fd);
+}
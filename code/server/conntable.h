@@ -0,0 +1,54 @@
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <sys/resource.h>
+#include <assert.h>
+
+#include "../http/httpconn.h"
+#include "../timer/timingwheel.h"
+
+/*
+ * 以fd为下标的连接表，所有Reactor共享（fd在进程内唯一）
+ * 每个槽位独占一条缓存行，HttpConn在该fd第一次使用时创建，之后一直复用，地址不变
+ * 事件数据 key = (代数 << 32) | fd，连接每次建立时代数加一，关闭后残留的事件或定时器凭代数即可识别
+ * 槽位内嵌连接的超时结点，由连接所在Reactor的时间轮串接
+ */
+class ConnTable {
+    public:
+        explicit ConnTable(size_t maxFd);
+        ~ConnTable() = default;
+
+        /* 为新连接分配槽位并返回其key，fd超出表大小时返回0 */
+        uint64_t open(int fd);
+
+        /* key已过期（连接已关闭或fd已被复用）时返回nullptr */
+        HttpConn* lookup(uint64_t key) const;
+
+        uint64_t key(int fd) const;
+
+        WheelNode* timerNode(int fd) {
+            assert(fd >= 0 && static_cast<size_t>(fd) < m_slots.size());
+            return &m_slots[fd].timer;
+        }
+
+        size_t size() const { return m_slots.size(); }
+
+        static int keyFd(uint64_t key) { return static_cast<int>(key & 0xffffffff); }
+
+        /* 按 RLIMIT_NOFILE 确定表大小，并以 maxFd 为上限 */
+        static size_t limitFd(size_t maxFd);
+
+    private:
+        struct alignas(64) Slot {
+            std::atomic<uint32_t> gen;
+            std::unique_ptr<HttpConn> conn;
+            WheelNode timer;
+        };
+
+        std::vector<Slot> m_slots;
+};
+
+#endif  //CONN_TABLE_H
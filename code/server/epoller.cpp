@@ -10,18 +10,18 @@ Epoller::~Epoller() {
     close(m_epollFd);
 }
 
-bool Epoller::addFd(int fd, uint32_t events) {
+bool Epoller::addFd(int fd, uint32_t events, uint64_t data) {
     if (fd < 0) return false;
     epoll_event ev = {0};
-    ev.data.fd = fd;
+    ev.data.u64 = data;
     ev.events = events;
     return 0 == epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
 }
 
-bool Epoller::modFd(int fd, uint32_t events) {
+bool Epoller::modFd(int fd, uint32_t events, uint64_t data) {
     if (fd < 0) return false;
     epoll_event ev = {0};
-    ev.data.fd = fd;
+    ev.data.u64 = data;
     ev.events = events;
     return 0 == epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &ev);
 }
@@ -38,7 +38,12 @@ int Epoller::wait(int timeoutMS) {
 
 int Epoller::getEventFd(size_t i) const {
     assert(i < m_events.size() && i >= 0);
-    return m_events[i].data.fd;
+    return static_cast<int>(m_events[i].data.u64 & 0xffffffff);
+}
+
+uint64_t Epoller::getEventData(size_t i) const {
+    assert(i < m_events.size() && i >= 0);
+    return m_events[i].data.u64;
 }
 
 uint32_t Epoller::getEvents(size_t i) const {
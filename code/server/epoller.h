@@ -8,23 +8,29 @@
 #include <errno.h>
 #include <vector>
 
-class Epoller {
+#include "poller.h"
+
+class Epoller : public Poller {
     public:
         explicit Epoller(int maxEvent = 1024);
 
-        ~Epoller();
+        ~Epoller() override;
+
+        bool addFd(int fd, uint32_t events, uint64_t data) override;
+
+        bool modFd(int fd, uint32_t events, uint64_t data) override;
 
-        bool addFd(int fd, uint32_t events);
+        bool delFd(int fd) override;
 
-        bool modFd(int fd, uint32_t events);
+        int wait(int timeoutMS = -1) override;
 
-        bool delFd(int fd);
+        int getEventFd(size_t i) const override;
 
-        int wait(int timeoutMS = -1);
+        uint64_t getEventData(size_t i) const override;
 
-        int getEventFd(size_t i) const;
+        uint32_t getEvents(size_t i) const override;
 
-        uint32_t getEvents(size_t i) const;
+        const char* name() const override { return "epoll"; }
 
     private:
         int m_epollFd;
@@ -0,0 +1,88 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <assert.h>
+
+/* 单生产者单消费者的无锁环形队列，容量向上取整为2的幂 */
+template<class T>
+class LockFreeQueue {
+    public:
+        explicit LockFreeQueue(size_t capacity = 1024);
+
+        ~LockFreeQueue() = default;
+
+        bool push(const T& item);
+
+        bool pop(T& item);
+
+        bool empty() const;
+
+        size_t size() const;
+
+        size_t capacity() const;
+
+    private:
+        std::vector<T> m_buffer;
+
+        size_t m_mask;
+
+        /* 生产者与消费者的游标分处不同缓存行，避免伪共享 */
+        char m_pad0[64];
+
+        std::atomic<size_t> m_head;  // 消费者读位置
+
+        char m_pad1[64 - sizeof(std::atomic<size_t>)];
+
+        std::atomic<size_t> m_tail;  // 生产者写位置
+};
+
+
+template<class T>
+LockFreeQueue<T>::LockFreeQueue(size_t capacity): m_head(0), m_tail(0) {
+    assert(capacity > 0);
+    size_t n = 1;
+    while (n < capacity) { n <<= 1; }
+    m_buffer.resize(n);
+    m_mask = n - 1;
+}
+
+template<class T>
+bool LockFreeQueue<T>::push(const T& item) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+        return false;
+    }
+    m_buffer[tail & m_mask] = item;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template<class T>
+bool LockFreeQueue<T>::pop(T& item) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    item = m_buffer[head & m_mask];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template<class T>
+bool LockFreeQueue<T>::empty() const {
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
+
+template<class T>
+size_t LockFreeQueue<T>::size() const {
+    return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+}
+
+template<class T>
+size_t LockFreeQueue<T>::capacity() const {
+    return m_buffer.size();
+}
+
+#endif  //LOCKFREEQUEUE_H
@@ -0,0 +1,42 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/epoll.h>
+
+/*
+ * IO多路复用后端的统一接口，事件掩码沿用epoll的EPOLLIN/EPOLLOUT/EPOLLONESHOT等定义
+ * data 随就绪事件原样带回（同 epoll_event.data.u64），低32位约定为fd
+ * 只负责就绪通知，各后端下accept/recv/send/sendfile仍由连接自己逐个发起系统调用
+ */
+class Poller {
+    public:
+        enum BACKEND {
+            EPOLL = 0,
+            IO_URING,
+        };
+
+        virtual ~Poller() = default;
+
+        virtual bool addFd(int fd, uint32_t events, uint64_t data) = 0;
+
+        virtual bool modFd(int fd, uint32_t events, uint64_t data) = 0;
+
+        virtual bool delFd(int fd) = 0;
+
+        virtual int wait(int timeoutMS = -1) = 0;
+
+        virtual int getEventFd(size_t i) const = 0;
+
+        virtual uint64_t getEventData(size_t i) const = 0;
+
+        virtual uint32_t getEvents(size_t i) const = 0;
+
+        virtual const char* name() const = 0;
+
+        /* 按指定后端创建，io_uring不可用时退回epoll */
+        static Poller* newPoller(int backend, int maxEvent = 1024);
+};
+
+#endif  //POLLER_H
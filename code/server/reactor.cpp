@@ -0,0 +1,285 @@
+#include "reactor.h"
+
+using namespace std;
+
+Reactor::Reactor(ConnTable* users, int timeoutMS, uint32_t listenEvent, uint32_t connEvent,
+            int pollerBackend, ThreadPool* threadpool):
+            m_timeoutMS(timeoutMS), m_isClose(false), m_listenFd(-1), m_connCount(0),
+            m_listenEvent(listenEvent), m_connEvent(connEvent), m_threadpool(threadpool),
+            m_timer(new TimingWheel([this](uint64_t key) { m_closeExpired(key); })), m_epoller(Poller::newPoller(pollerBackend)), m_users(users), m_pausedCnt(0) {
+    assert(m_users);
+    /* eventfd 用于其他线程投递新连接或退出时唤醒阻塞在epoll_wait上的本循环 */
+    m_wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(m_wakeupFd >= 0);
+    m_epoller->addFd(m_wakeupFd, EPOLLIN, m_wakeupFd);
+}
+
+Reactor::~Reactor() {
+    m_isClose = true;
+    PendingClient client;
+    while (m_pending.pop(client)) {
+        close(client.fd);
+    }
+    close(m_wakeupFd);
+}
+
+bool Reactor::addListen(int listenFd) {
+    /* 将listenFd以 EPOLLIN 和 m_listenEvent 为事件类型，注册到本循环的m_epoller中 */
+    /* 当listen到新的客户连接时，listenFd变为就绪事件 */
+    if (!m_epoller->addFd(listenFd, m_listenEvent | EPOLLIN, listenFd)) {
+        return false;
+    }
+    m_listenFd = listenFd;
+    return true;
+}
+
+void Reactor::loop() {
+    int timeMS = -1;  /* epoll wait timeout == -1 无事件将阻塞 */
+    while (!m_isClose) {
+        if (m_timeoutMS > 0) {
+            timeMS = m_timer->getNextTick();
+        }
+        int waitMS = timeMS;
+        if (m_pausedCnt > 0) {
+            /* 其他连接发送完释放缓冲区不会唤醒本循环，定期检查暂停的连接 */
+            m_resumeRead();
+            if (waitMS < 0 || waitMS > RESUME_INTERVAL_MS) { waitMS = RESUME_INTERVAL_MS; }
+        }
+        /* 调用epoll_wait等待文件描述符上的事件，并将当前所有就绪的epoll_event复制到m_events数组中 */
+        int eventCnt = m_epoller->wait(waitMS);
+        HttpDate::tick();
+        for (int i = 0; i < eventCnt; ++i) {
+            /* 处理事件，事件数据直接携带连接槽位的key，无需哈希查找 */
+            uint64_t key = m_epoller->getEventData(i);
+            int fd = ConnTable::keyFd(key);
+            uint32_t events = m_epoller->getEvents(i);
+            if (fd == m_listenFd) {
+                m_dealListen();
+                continue;
+            } else if (fd == m_wakeupFd) {
+                m_dealWakeup();
+                continue;
+            }
+            HttpConn* client = m_users->lookup(key);
+            if (!client) {
+                /* 同一批次中已关闭的连接残留的事件 */
+                continue;
+            }
+            /* 如有异常，则关闭客户连接 */
+            if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                m_closeConn(client);
+            } else if (events & EPOLLIN) {
+                m_dealRead(client);
+            } else if (events & EPOLLOUT) {
+                m_dealWrite(client);
+            } else {
+                LOG_ERROR("Unexpected event");
+            }
+        }
+    }
+}
+
+void Reactor::quit() {
+    m_isClose = true;
+    m_wakeup();
+}
+
+bool Reactor::queueClient(int fd, const sockaddr_in& addr) {
+    /* 由主Reactor线程调用，连接的后续处理全部在本循环线程上进行 */
+    if (!m_pending.push({fd, addr})) {
+        return false;
+    }
+    m_wakeup();
+    return true;
+}
+
+void Reactor::m_wakeup() {
+    uint64_t one = 1;
+    ssize_t ret = write(m_wakeupFd, &one, sizeof(one));
+    if (ret != sizeof(one)) {
+        LOG_WARN("Reactor wakeup error!");
+    }
+}
+
+void Reactor::m_dealWakeup() {
+    uint64_t cnt = 0;
+    ssize_t ret = read(m_wakeupFd, &cnt, sizeof(cnt));
+    if (ret != sizeof(cnt) && errno != EAGAIN) {
+        LOG_WARN("Reactor wakeup read error!");
+    }
+    PendingClient client;
+    while (m_pending.pop(client)) {
+        m_addClient(client.fd, client.addr);
+    }
+}
+
+void Reactor::m_addClient(int connFd, sockaddr_in addr) {
+    assert(connFd > 0);
+    uint64_t key = m_users->open(connFd);
+    if (key == 0) {
+        sendError(connFd, "Server busy!");
+        LOG_WARN("Client fd[%d] out of table!", connFd);
+        return;
+    }
+    HttpConn* client = m_users->lookup(key);
+    client->init(connFd, addr);
+    m_connCount++;
+    if (m_timeoutMS > 0) {
+        m_timer->add(m_users->timerNode(connFd), m_timeoutMS, key);
+    }
+    m_epoller->addFd(connFd, EPOLLIN | m_connEvent, key);
+    setFdNonblock(connFd);
+    LOG_INFO("Client[%d] in!", client->getFd());
+}
+
+void Reactor::m_dealListen() {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    do {
+        int connFd = accept(m_listenFd, (struct sockaddr *)&addr, &len);
+        if (connFd <= 0) { return; }
+        else if (HttpConn::userCount >= MAX_FD || static_cast<size_t>(connFd) >= m_users->size()) {
+            sendError(connFd, "Server busy!");
+            LOG_WARN("Clients is full!");
+            return;
+        }
+        m_addClient(connFd, addr);
+    } while (m_listenEvent & EPOLLET);
+}
+
+void Reactor::m_dealRead(HttpConn* client) {
+    assert(client);
+    m_extentTime(client);
+    if (m_threadpool) {
+        m_threadpool->addTask(std::bind(&Reactor::m_onRead, this, client));
+    } else {
+        m_onRead(client);
+    }
+}
+
+void Reactor::m_dealWrite(HttpConn* client) {
+    assert(client);
+    m_extentTime(client);
+    if (m_threadpool) {
+        m_threadpool->addTask(std::bind(&Reactor::m_onWrite, this, client));
+    } else {
+        m_onWrite(client);
+    }
+}
+
+void Reactor::sendError(int fd, const char*info) {
+    assert(fd > 0);
+    int ret = send(fd, info, strlen(info), 0);
+    if (ret < 0) {
+        LOG_WARN("send error to client[%d] error!", fd);
+    }
+    close(fd);
+}
+
+void Reactor::m_extentTime(HttpConn* client) {
+    assert(client);
+    if (m_timeoutMS > 0) { m_timer->adjust(m_users->timerNode(client->getFd()), m_timeoutMS); }
+}
+
+void Reactor::m_closeConn(HttpConn* client) {
+    assert(client);
+    if (client->isClose()) { return; }
+    LOG_INFO("Client[%d] quit!", client->getFd());
+    m_epoller->delFd(client->getFd());
+    if (!m_threadpool) {
+        /* 时间轮只在本循环线程上操作；线程池模式下结点留到到期或该fd再次建立连接时处理 */
+        m_timer->cancel(m_users->timerNode(client->getFd()));
+    }
+    client->closeConn();
+    m_connCount--;
+}
+
+void Reactor::m_closeExpired(uint64_t key) {
+    /* 定时器只凭key找连接，连接已关闭或fd已被复用时不做处理 */
+    HttpConn* client = m_users->lookup(key);
+    if (client) {
+        m_closeConn(client);
+    }
+}
+
+void Reactor::m_modFd(HttpConn* client, uint32_t events) {
+    m_epoller->modFd(client->getFd(), events, m_users->key(client->getFd()));
+}
+
+void Reactor::m_onRead(HttpConn* client) {
+    assert(client);
+    int ret = -1;
+    int readErrno = 0;
+    ret = client->read(&readErrno);
+    if (ret <= 0 && readErrno != EAGAIN) {
+        m_closeConn(client);
+        return;
+    }
+    m_onProcess(client);
+}
+
+void Reactor::m_onProcess(HttpConn* client) {
+    if (client->process()) {
+        m_modFd(client, m_connEvent | EPOLLOUT);
+    } else if (client->isReadPaused()) {
+        /* 超过水位时不注册EPOLLIN，由事件循环在回落后恢复 */
+        m_pauseRead(client);
+    } else {
+        m_modFd(client, m_connEvent | EPOLLIN);
+    }
+}
+
+void Reactor::m_pauseRead(HttpConn* client) {
+    lock_guard<mutex> locker(m_pausedMtx);
+    m_paused.push_back(m_users->key(client->getFd()));
+    m_pausedCnt = m_paused.size();
+}
+
+void Reactor::m_resumeRead() {
+    /* 暂停的连接没有注册任何事件，不会同时被工作线程处理 */
+    vector<uint64_t> paused;
+    {
+        lock_guard<mutex> locker(m_pausedMtx);
+        paused.swap(m_paused);
+    }
+    vector<uint64_t> still;
+    for (uint64_t key: paused) {
+        HttpConn* client = m_users->lookup(key);
+        if (!client || client->isClose()) {
+            /* 期间已超时关闭 */
+            continue;
+        }
+        if (client->resumeRead()) {
+            m_modFd(client, m_connEvent | EPOLLIN);
+        } else {
+            still.push_back(key);
+        }
+    }
+    lock_guard<mutex> locker(m_pausedMtx);
+    m_paused.insert(m_paused.end(), still.begin(), still.end());
+    m_pausedCnt = m_paused.size();
+}
+
+void Reactor::m_onWrite(HttpConn* client) {
+    assert(client);
+    int ret = -1;
+    int writeErrno = 0;
+    ret = client->write(&writeErrno);
+    if (client->toWriteBytes() == 0) {
+        /* 传输完成 */
+        if (client->isKeepAlive()) {
+            m_onProcess(client);
+            return;
+        }
+    } else if (ret > 0 || writeErrno == EAGAIN) {
+        /* 继续传输：socket写满，或LT模式下本次已写够一批 */
+        m_modFd(client, m_connEvent | EPOLLOUT);
+        return;
+    }
+    m_closeConn(client);
+}
+
+int Reactor::setFdNonblock(int fd) {
+    assert(fd > 0);
+    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);    //用F_GETFL获取文件描述符旧的状态标志位，再用F_SETFL设置为新的非阻塞的状态标志位
+}
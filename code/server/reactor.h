@@ -0,0 +1,100 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "poller.h"
+#include "lockfreequeue.h"
+#include "conntable.h"
+#include "../log/log.h"
+#include "../timer/timingwheel.h"
+#include "../pool/threadpool.h"
+#include "../http/httpconn.h"
+#include "../http/httpdate.h"
+
+/*
+ * 一个事件循环：独占自己的 Poller（epoll 或 io_uring）与 TimingWheel，连接槽位取自共享的 ConnTable
+ * threadpool 不为空时读写任务交给线程池（Reactor + 线程池模型），
+ * 为空时在本线程内完成读写，连接从建立到关闭都只在本线程上（one loop per thread）
+ * 主从Reactor模式下由主Reactor accept后经 queueClient 投递，eventfd 唤醒本循环接管连接
+ */
+class Reactor {
+    public:
+        Reactor(ConnTable* users, int timeoutMS, uint32_t listenEvent, uint32_t connEvent,
+                int pollerBackend = Poller::EPOLL, ThreadPool* threadpool = nullptr);
+        ~Reactor();
+
+        bool addListen(int listenFd);
+        bool queueClient(int fd, const sockaddr_in& addr);
+        const char* pollerName() const { return m_epoller->name(); }
+        int connCount() const { return m_connCount; }
+
+        void loop();
+        void quit();
+
+        static int setFdNonblock(int fd);
+        static void sendError(int fd, const char*info);
+
+        static const int MAX_FD = 65536;
+
+    private:
+        struct PendingClient {
+            int fd;
+            sockaddr_in addr;
+        };
+
+        void m_addClient(int fd, sockaddr_in addr);
+
+        void m_dealListen();
+        void m_dealWakeup();
+        void m_wakeup();
+        void m_dealWrite(HttpConn* client);
+        void m_dealRead(HttpConn* client);
+
+        void m_extentTime(HttpConn* client);
+        void m_closeConn(HttpConn* client);
+        void m_closeExpired(uint64_t key);
+        void m_modFd(HttpConn* client, uint32_t events);
+
+        void m_onRead(HttpConn* client);
+        void m_onWrite(HttpConn* client);
+        void m_onProcess(HttpConn* client);
+
+        void m_pauseRead(HttpConn* client);
+        void m_resumeRead();
+
+        /* 有暂停读取的连接时，事件循环至少每隔这么久检查一次能否恢复 */
+        static const int RESUME_INTERVAL_MS = 10;
+
+        int m_timeoutMS;  /* 毫秒MS */
+        std::atomic<bool> m_isClose;
+        int m_listenFd;
+        int m_wakeupFd;
+        std::atomic<int> m_connCount;
+
+        uint32_t m_listenEvent;
+        uint32_t m_connEvent;
+
+        ThreadPool* m_threadpool;
+        std::unique_ptr<TimingWheel> m_timer;
+        std::unique_ptr<Poller> m_epoller;
+        ConnTable* m_users;
+        LockFreeQueue<PendingClient> m_pending;
+
+        /* 因背压暂停读取、等待恢复的连接，线程池模式下由工作线程加入 */
+        std::mutex m_pausedMtx;
+        std::vector<uint64_t> m_paused;
+        std::atomic<size_t> m_pausedCnt;
+};
+
+#endif  //REACTOR_H
@@ -0,0 +1,266 @@
+#include "uringpoller.h"
+
+UringPoller::UringPoller(int maxEvent):
+            m_ringFd(-1), m_sqRing(MAP_FAILED), m_cqRing(MAP_FAILED), m_sqes(nullptr),
+            m_inWait(false), m_fds(1024), m_events(maxEvent) {
+    assert(m_events.size() > 0);
+    /* CQ 默认为 SQ 的两倍，足以容纳所有连接同时就绪 */
+    if (!m_setup(static_cast<unsigned>(maxEvent))) {
+        if (m_ringFd >= 0) {
+            close(m_ringFd);
+            m_ringFd = -1;
+        }
+    }
+}
+
+UringPoller::~UringPoller() {
+    if (m_sqes) { munmap(m_sqes, m_sqesSize); }
+    if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) { munmap(m_cqRing, m_cqRingSize); }
+    if (m_sqRing != MAP_FAILED) { munmap(m_sqRing, m_sqRingSize); }
+    if (m_ringFd >= 0) { close(m_ringFd); }
+}
+
+bool UringPoller::m_setup(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    m_ringFd = syscall(__NR_io_uring_setup, entries, &params);
+    if (m_ringFd < 0) {
+        return false;
+    }
+    /* wait 依赖 IORING_ENTER_EXT_ARG 传入超时 (Linux 5.11+) */
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        return false;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (m_cqRingSize > m_sqRingSize) { m_sqRingSize = m_cqRingSize; }
+        m_cqRingSize = m_sqRingSize;
+    }
+    m_sqRing = mmap(0, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED) {
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_cqRing = m_sqRing;
+    } else {
+        m_cqRing = mmap(0, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED) {
+            return false;
+        }
+    }
+    m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(0, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(m_sqRing);
+    m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    m_sqEntries = params.sq_entries;
+
+    char* cq = static_cast<char*>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+unsigned UringPoller::m_pending() const {
+    /* 已填入SQ但尚未被内核取走的请求数 */
+    return *m_sqTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+}
+
+int UringPoller::m_enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize) {
+    return syscall(__NR_io_uring_enter, m_ringFd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+io_uring_sqe* UringPoller::m_getSqe() {
+    unsigned tail = *m_sqTail;
+    if (tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries) {
+        /* SQ已满，先把已有的提交出去 */
+        m_enter(m_pending(), 0, 0, nullptr, 0);
+        if (tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries) {
+            return nullptr;
+        }
+    }
+    unsigned idx = tail & *m_sqMask;
+    io_uring_sqe* sqe = &m_sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sqArray[idx] = idx;
+    return sqe;
+}
+
+UringPoller::FdState& UringPoller::m_state(int fd) {
+    if (static_cast<size_t>(fd) >= m_fds.size()) {
+        m_fds.resize(fd * 2 + 1);
+    }
+    return m_fds[fd];
+}
+
+void UringPoller::m_pollAdd(int fd) {
+    FdState& st = m_fds[fd];
+    io_uring_sqe* sqe = m_getSqe();
+    if (!sqe) { return; }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    /* EPOLLIN/EPOLLOUT/EPOLLRDHUP 等与 poll 位定义相同，ET/ONESHOT 由本类模拟 */
+    sqe->poll32_events = st.events & ~(EPOLLET | EPOLLONESHOT);
+    if ((st.events & EPOLLET) && !(st.events & EPOLLONESHOT)) {
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    sqe->user_data = m_userData(fd, st.gen);
+    __atomic_store_n(m_sqTail, *m_sqTail + 1, __ATOMIC_RELEASE);
+    st.armed = true;
+}
+
+void UringPoller::m_pollRemove(int fd) {
+    FdState& st = m_fds[fd];
+    io_uring_sqe* sqe = m_getSqe();
+    if (!sqe) { return; }
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = m_userData(fd, st.gen);
+    sqe->user_data = REMOVE_TAG;
+    __atomic_store_n(m_sqTail, *m_sqTail + 1, __ATOMIC_RELEASE);
+    st.armed = false;
+}
+
+void UringPoller::m_flushIfWaiting() {
+    /* 事件循环正阻塞在 io_uring_enter 中时，由调用线程直接提交 */
+    if (m_inWait && m_pending() > 0) {
+        m_enter(m_pending(), 0, 0, nullptr, 0);
+    }
+}
+
+bool UringPoller::addFd(int fd, uint32_t events, uint64_t data) {
+    if (fd < 0) return false;
+    std::lock_guard<std::mutex> locker(m_mtx);
+    FdState& st = m_state(fd);
+    if (st.armed) { return false; }
+    st.gen++;
+    st.events = events;
+    st.data = data;
+    m_pollAdd(fd);
+    m_flushIfWaiting();
+    return true;
+}
+
+bool UringPoller::modFd(int fd, uint32_t events, uint64_t data) {
+    if (fd < 0) return false;
+    std::lock_guard<std::mutex> locker(m_mtx);
+    FdState& st = m_state(fd);
+    if (st.armed) { m_pollRemove(fd); }
+    /* 旧的poll请求即使已产生完成事件也会因代数不匹配被丢弃 */
+    st.gen++;
+    st.events = events;
+    st.data = data;
+    m_pollAdd(fd);
+    m_flushIfWaiting();
+    return true;
+}
+
+bool UringPoller::delFd(int fd) {
+    if (fd < 0) return false;
+    std::lock_guard<std::mutex> locker(m_mtx);
+    FdState& st = m_state(fd);
+    if (st.armed) { m_pollRemove(fd); }
+    st.gen++;
+    st.events = 0;
+    m_flushIfWaiting();
+    return true;
+}
+
+int UringPoller::wait(int timeoutMS) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMS, 0));
+    std::unique_lock<std::mutex> locker(m_mtx);
+    while (true) {
+        unsigned toSubmit = m_pending();
+        m_inWait = true;
+        locker.unlock();
+        /* 一次系统调用：提交积攒的 POLL_ADD/POLL_REMOVE 并等待至少一个完成事件或超时 */
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        if (timeoutMS >= 0) {
+            long long left = std::max<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    deadline - std::chrono::steady_clock::now()).count(), 0);
+            ts.tv_sec = left / 1000;
+            ts.tv_nsec = (left % 1000) * 1000000LL;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+        unsigned minComplete = (timeoutMS == 0) ? 0 : 1;
+        /* 超时返回ETIME，其余错误下CQ中仍可能有事件，一并收割 */
+        int ret = m_enter(toSubmit, minComplete, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        int err = errno;
+
+        locker.lock();
+        m_inWait = false;
+        int n = m_reap();
+        /*
+         * 没有可返回的事件时继续等待：完成的只是被取代的旧请求或POLL_REMOVE，
+         * 或其他线程在本线程进入内核前把积攒的请求一起提交走了（内核提交数少于toSubmit时不等待就返回）
+         */
+        bool expired = timeoutMS == 0 || (timeoutMS > 0 && std::chrono::steady_clock::now() >= deadline);
+        if (n > 0 || expired || (ret < 0 && err != ETIME)) {
+            return n;
+        }
+    }
+}
+
+int UringPoller::m_reap() {
+    int n = 0;
+    unsigned head = *m_cqHead;
+    unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail && static_cast<size_t>(n) < m_events.size()) {
+        const io_uring_cqe& cqe = m_cqes[head & *m_cqMask];
+        head++;
+        if (cqe.user_data == REMOVE_TAG) { continue; }
+        int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+        uint32_t gen = static_cast<uint32_t>(cqe.user_data >> 32);
+        if (static_cast<size_t>(fd) >= m_fds.size() || m_fds[fd].gen != gen) {
+            continue;  /* 已被 modFd/delFd 取代的旧请求 */
+        }
+        FdState& st = m_fds[fd];
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            st.armed = false;
+        }
+        if (cqe.res < 0) {
+            if (cqe.res == -ECANCELED) { continue; }
+            m_events[n].data.u64 = st.data;
+            m_events[n].events = EPOLLERR;
+            n++;
+            continue;
+        }
+        m_events[n].data.u64 = st.data;
+        m_events[n].events = static_cast<uint32_t>(cqe.res);
+        n++;
+        /* 非ONESHOT的注册在单次poll完成后自动重新挂上，模拟epoll的持续关注 */
+        if (!st.armed && !(st.events & EPOLLONESHOT)) {
+            m_pollAdd(fd);
+        }
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+int UringPoller::getEventFd(size_t i) const {
+    assert(i < m_events.size() && i >= 0);
+    return static_cast<int>(m_events[i].data.u64 & 0xffffffff);
+}
+
+uint64_t UringPoller::getEventData(size_t i) const {
+    assert(i < m_events.size() && i >= 0);
+    return m_events[i].data.u64;
+}
+
+uint32_t UringPoller::getEvents(size_t i) const {
+    assert(i < m_events.size() && i >= 0);
+    return m_events[i].events;
+}
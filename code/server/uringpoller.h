@@ -0,0 +1,102 @@
+#ifndef URING_POLLER_H
+#define URING_POLLER_H
+
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+
+#include "poller.h"
+
+/*
+ * 基于io_uring的就绪通知Poller：addFd/modFd/delFd 只是往SQ中填入 POLL_ADD/POLL_REMOVE，
+ * 在下一次 wait 时与等待超时一起由一次 io_uring_enter 提交，省去每次事件后的 epoll_ctl 系统调用；
+ * 读写本身不经过环，与epoll后端相同
+ * 其他线程（线程池）在循环阻塞等待期间修改事件时立即提交，避免唤醒延迟
+ */
+class UringPoller : public Poller {
+    public:
+        explicit UringPoller(int maxEvent = 1024);
+
+        ~UringPoller() override;
+
+        bool isValid() const { return m_ringFd >= 0; }
+
+        bool addFd(int fd, uint32_t events, uint64_t data) override;
+
+        bool modFd(int fd, uint32_t events, uint64_t data) override;
+
+        bool delFd(int fd) override;
+
+        int wait(int timeoutMS = -1) override;
+
+        int getEventFd(size_t i) const override;
+
+        uint64_t getEventData(size_t i) const override;
+
+        uint32_t getEvents(size_t i) const override;
+
+        const char* name() const override { return "io_uring"; }
+
+    private:
+        struct FdState {
+            uint32_t gen;
+            uint32_t events;
+            bool armed;
+            uint64_t data;
+        };
+
+        bool m_setup(unsigned entries);
+        io_uring_sqe* m_getSqe();
+        void m_pollAdd(int fd);
+        void m_pollRemove(int fd);
+        void m_flushIfWaiting();
+        /* 收割CQ中的完成事件，须持有m_mtx */
+        int m_reap();
+        unsigned m_pending() const;
+        int m_enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize);
+        FdState& m_state(int fd);
+
+        static uint64_t m_userData(int fd, uint32_t gen) {
+            return (static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(fd);
+        }
+
+        static const uint64_t REMOVE_TAG = ~0ULL;
+
+        int m_ringFd;
+
+        /* SQ/CQ 环形队列的共享内存映射 */
+        void* m_sqRing;
+        void* m_cqRing;
+        size_t m_sqRingSize;
+        size_t m_cqRingSize;
+        io_uring_sqe* m_sqes;
+        size_t m_sqesSize;
+
+        unsigned* m_sqHead;
+        unsigned* m_sqTail;
+        unsigned* m_sqMask;
+        unsigned* m_sqArray;
+        unsigned m_sqEntries;
+
+        unsigned* m_cqHead;
+        unsigned* m_cqTail;
+        unsigned* m_cqMask;
+        io_uring_cqe* m_cqes;
+
+        bool m_inWait;
+
+        std::mutex m_mtx;
+        std::vector<FdState> m_fds;
+        std::vector<struct epoll_event> m_events;
+};
+
+#endif  //URING_POLLER_H
@@ -5,19 +5,24 @@ using namespace std;
 WebServer::WebServer(
             int port, int trigMode, int timeoutMS, bool optLinger,
             int sqlPort, const char* sqlUser, const char* sqlPwd, const char* dbName,
-            int connPoolNum, int threadNum, bool openLog, int logLevel, int logQueSize):
+            int connPoolNum, int threadNum, bool openLog, int logLevel, int logQueSize,
+            int reactorMode, int reactorNum, int dispatchPolicy, int pollerBackend, const char* packPath):
             m_port(port), m_timeoutMS(timeoutMS), m_openLinger(optLinger), m_isClose(false),
-            m_timer(new HeapTimer()), m_threadpool(new ThreadPool(threadNum)), m_epoller(new Epoller())
+            m_reactorMode(reactorMode), m_dispatchPolicy(dispatchPolicy),
+            m_pollerBackend(pollerBackend), m_nextIdx(0)
     {
     m_srcDir = getcwd(nullptr, 256);
     assert(m_srcDir);
     strncat(m_srcDir, "/resources/", 16);
     HttpConn::userCount = 0;
     HttpConn::srcDir = m_srcDir;
+    /* 对端已关闭时sendfile/writev会触发SIGPIPE，忽略后由返回的EPIPE关闭连接 */
+    signal(SIGPIPE, SIG_IGN);
     SqlConnPool::getInstance()->initPool("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
     
     m_initEventMode(trigMode);
-    if (!m_initSocket()) { m_isClose = true;}
+    m_users.reset(new ConnTable(ConnTable::limitFd(Reactor::MAX_FD)));
+    if (!m_initReactors(reactorNum, threadNum)) { m_isClose = true;}
 
     if (openLog) {
         Log::getInstance()->init(logLevel, "./log", ".log", logQueSize);
@@ -31,48 +36,68 @@ WebServer::WebServer(
                             (m_connEvent & EPOLLET ? "ET": "LT"));
             LOG_INFO("LogSys level: %d", logLevel);
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("Reactor Mode: %s, Reactor num: %d",
+                            (m_reactorMode == POOL_REACTOR ? "Reactor+ThreadPool" :
+                             m_reactorMode == REUSEPORT_REACTOR ? "SO_REUSEPORT" :
+                             m_dispatchPolicy == LEAST_CONN ? "Main/Sub (least-conn)" : "Main/Sub (round-robin)"),
+                            (int)m_reactors.size());
+            LOG_INFO("Poller: %s, ConnTable size: %d", m_reactors[0]->pollerName(), (int)m_users->size());
+            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, m_threadpool ? threadNum : 0);
         }
     }
+    FileCache::getInstance()->init(m_srcDir);
+    if (packPath && !FileCache::getInstance()->loadPack(packPath)) {
+        LOG_ERROR("Load asset pack %s error!", packPath);
+        m_isClose = true;
+    }
+    ResponseCache::getInstance()->init();
+    HttpResponse::loadErrorPages(m_srcDir);
 }
 
 WebServer::~WebServer() {
-    close(m_listenFd);
     m_isClose = true;
+    for (auto& reactor: m_reactors) {
+        reactor->quit();
+    }
+    for (int fd: m_listenFds) {
+        close(fd);
+    }
     free(m_srcDir);
+    ResponseCache* cache = ResponseCache::getInstance();
+    LOG_INFO("Response cache hit: %llu, miss: %llu, eviction: %llu, entries: %zu",
+                    (unsigned long long)cache->hits(), (unsigned long long)cache->misses(),
+                    (unsigned long long)cache->evictions(), cache->size());
+    LOG_INFO("Connection buffers: %zu KB, paused readers: %d",
+                    HttpConn::totalBuffered.load() >> 10, HttpConn::pausedCount.load());
+    LOG_INFO("Buffer pool hit: %llu, miss: %llu, resident: %zu KB, cached: %zu KB",
+                    (unsigned long long)BufferPool::hits(), (unsigned long long)BufferPool::misses(),
+                    BufferPool::residentBytes() >> 10, BufferPool::cachedBytes() >> 10);
     SqlConnPool::getInstance()->closePool();
 }
 
 void WebServer::start() {
-    int timeMS = -1;  /* epoll wait timeout == -1 无事件将阻塞 */
-    if (!m_isClose) { LOG_INFO("========== Server start =========="); }
-    while (!m_isClose) {
-        if (m_timeoutMS > 0) {
-            timeMS = m_timer->getNextTick();
-        }
-        /* 调用epoll_wait等待文件描述符上的事件，并将当前所有就绪的epoll_event复制到m_events数组中 */
-        int eventCnt = m_epoller->wait(timeMS);
-        for (int i = 0; i < eventCnt; ++i) {
-            /* 处理事件 */
-            int fd = m_epoller->getEventFd(i);
-            uint32_t events = m_epoller->getEvents(i);
-            i f(fd == m_listenFd) {
-                m_dealListen();
-            }
-            /* 如有异常，则关闭客户连接 */
-            else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                assert(m_users.count(fd) > 0);
-                m_closeConn(&m_users[fd]);
-            } else if (events & EPOLLIN) {
-                assert(m_users.count(fd) > 0);
-                m_dealRead(&m_users[fd]);
-            } else if (events & EPOLLOUT) {
-                assert(m_users.count(fd) > 0);
-                m_dealWrite(&m_users[fd]);
-            } else {
-                LOG_ERROR("Unexpected event");
+    if (m_isClose) { return; }
+    LOG_INFO("========== Server start ==========");
+    /* 主从模式下主线程只负责accept，所有从Reactor各占一个线程；否则主线程运行第一个Reactor */
+    size_t first = (m_reactorMode == MAIN_SUB_REACTOR) ? 0 : 1;
+    std::vector<std::thread> threads;
+    for (size_t i = first; i < m_reactors.size(); ++i) {
+        threads.emplace_back(&Reactor::loop, m_reactors[i].get());
+    }
+    if (m_reactorMode == MAIN_SUB_REACTOR) {
+        while (!m_isClose) {
+            int eventCnt = m_epoller->wait(-1);
+            for (int i = 0; i < eventCnt; ++i) {
+                if (m_epoller->getEventFd(i) == m_listenFds[0]) {
+                    m_dealListen();
+                }
             }
         }
+    } else {
+        m_reactors[0]->loop();
+    }
+    for (auto& t: threads) {
+        t.join();
     }
 }
 
@@ -100,8 +125,93 @@ void WebServer::m_initEventMode(int trigMode) {
     HttpConn::isET = (m_connEvent & EPOLLET);
 }
 
+bool WebServer::m_initReactors(int reactorNum, int threadNum) {
+    if (m_reactorMode == POOL_REACTOR) {
+        /* 单Reactor：主线程监听与分发，读写交给线程池 */
+        reactorNum = 1;
+        m_threadpool.reset(new ThreadPool(threadNum));
+    }
+    if (reactorNum <= 0) {
+        LOG_ERROR("Reactor num:%d error!", reactorNum);
+        return false;
+    }
+    if (m_reactorMode == MAIN_SUB_REACTOR) {
+        /* 主从Reactor：只有一个监听socket，注册在主Reactor上，从Reactor只管理已建立的连接 */
+        int listenFd = -1;
+        if (!m_initSocket(listenFd, false)) {
+            return false;
+        }
+        m_listenFds.push_back(listenFd);
+        m_epoller.reset(Poller::newPoller(m_pollerBackend));
+        if (!m_epoller->addFd(listenFd, m_listenEvent | EPOLLIN, listenFd)) {
+            LOG_ERROR("Add listen error!");
+            return false;
+        }
+        Reactor::setFdNonblock(listenFd);
+        for (int i = 0; i < reactorNum; ++i) {
+            m_reactors.emplace_back(new Reactor(m_users.get(), m_timeoutMS, m_listenEvent, m_connEvent,
+                                                m_pollerBackend));
+        }
+        return true;
+    }
+    for (int i = 0; i < reactorNum; ++i) {
+        int listenFd = -1;
+        if (!m_initSocket(listenFd, m_reactorMode == REUSEPORT_REACTOR)) {
+            return false;
+        }
+        m_listenFds.push_back(listenFd);
+        m_reactors.emplace_back(new Reactor(m_users.get(), m_timeoutMS, m_listenEvent, m_connEvent,
+                                            m_pollerBackend, m_threadpool.get()));
+        if (!m_reactors.back()->addListen(listenFd)) {
+            LOG_ERROR("Add listen error!");
+            return false;
+        }
+        Reactor::setFdNonblock(listenFd);
+    }
+    return true;
+}
+
+void WebServer::m_dealListen() {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    do {
+        int connFd = accept(m_listenFds[0], (struct sockaddr *)&addr, &len);
+        if (connFd <= 0) { return; }
+        else if (HttpConn::userCount >= Reactor::MAX_FD || static_cast<size_t>(connFd) >= m_users->size()) {
+            Reactor::sendError(connFd, "Server busy!");
+            LOG_WARN("Clients is full!");
+            return;
+        }
+        if (!m_nextReactor()->queueClient(connFd, addr)) {
+            Reactor::sendError(connFd, "Server busy!");
+            LOG_WARN("Reactor queue is full!");
+        }
+    } while (m_listenEvent & EPOLLET);
+}
+
+Reactor* WebServer::m_nextReactor() {
+    /* 轮询或选择当前连接数最少的从Reactor */
+    if (m_dispatchPolicy == LEAST_CONN) {
+        size_t idx = m_nextIdx;
+        int minCnt = m_reactors[idx]->connCount();
+        for (size_t i = 1; i < m_reactors.size(); ++i) {
+            size_t j = (m_nextIdx + i) % m_reactors.size();
+            int cnt = m_reactors[j]->connCount();
+            if (cnt < minCnt) {
+                minCnt = cnt;
+                idx = j;
+            }
+        }
+        m_nextIdx = (idx + 1) % m_reactors.size();
+        return m_reactors[idx].get();
+    }
+    Reactor* reactor = m_reactors[m_nextIdx].get();
+    m_nextIdx = (m_nextIdx + 1) % m_reactors.size();
+    return reactor;
+}
+
 /* Create listenFd */
-bool WebServer::m_initSocket() {
+bool WebServer::m_initSocket(int& listenFd, bool reusePort) {
     if (m_port > 65535 || m_port < 1024) {
         LOG_ERROR("Port:%d error!",  m_port);
         return false;
@@ -120,15 +230,15 @@ bool WebServer::m_initSocket() {
         optLinger.l_linger = 1;
     }
 
-    m_listenFd = socket(AF_INET, SOCK_STREAM, 0);  //PF_INET用于IPv4，SOCK_STREAM表示传输层使用TCP协议，在前两个参数都设置好的情况下，第三个参数设置为0，表示使用默认协议
-    if (m_listenFd < 0) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);  //PF_INET用于IPv4，SOCK_STREAM表示传输层使用TCP协议，在前两个参数都设置好的情况下，第三个参数设置为0，表示使用默认协议
+    if (listenFd < 0) {
         LOG_ERROR("Create socket error!", m_port);
         return false;
     }
 
-    ret = setsockopt(m_listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));  //SO_LINGER选项根据不同的linger结构体成员变量值来控制close系统调用在关闭TCP连接时的行为
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));  //SO_LINGER选项根据不同的linger结构体成员变量值来控制close系统调用在关闭TCP连接时的行为
     if (ret < 0) {
-        close(m_listenFd);
+        close(listenFd);
         LOG_ERROR("Init linger error!", m_port);
         return false;
     }
@@ -136,144 +246,39 @@ bool WebServer::m_initSocket() {
     int reuse = 1;
     /* 端口复用 */
     /* 但是，这些套接字并不是所有都能读取信息，只有最后一个套接字会正常接收数据。 */
-    ret = setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, (const void*)&reuse, sizeof(int));  //reuse=0，将已经处于连接状态的socket在调用close(socket)后强制关闭，不经历TIME_WAIT的过程
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, (const void*)&reuse, sizeof(int));  //reuse=0，将已经处于连接状态的socket在调用close(socket)后强制关闭，不经历TIME_WAIT的过程
     if (ret == -1) {
         LOG_ERROR("set socket setsockopt error !");
-        close(m_listenFd);
+        close(listenFd);
         return false;
     }
 
+    if (reusePort) {
+        /* 多个socket绑定同一端口，由内核在各监听socket间分摊新连接 */
+        ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, (const void*)&reuse, sizeof(int));
+        if (ret == -1) {
+            LOG_ERROR("set socket SO_REUSEPORT error !");
+            close(listenFd);
+            return false;
+        }
+    }
+
     /* 绑定socket文件描述符和监听socket的TCP/IP的IPV4 socket地址 */
-    ret = bind(m_listenFd, (struct sockaddr *)&addr, sizeof(addr));
+    ret = bind(listenFd, (struct sockaddr *)&addr, sizeof(addr));
     if (ret < 0) {
         LOG_ERROR("Bind Port:%d error!", m_port);
-        close(m_listenFd);
+        close(listenFd);
         return false;
     }
 
     /* 创建监听队列以存放待处理的客户连接，在这些客户连接被accept()之前 */
-    ret = listen(m_listenFd, 5);    ////backlog参数表示内核监听队列的最大长度，典型值是5
+    ret = listen(listenFd, 5);    ////backlog参数表示内核监听队列的最大长度，典型值是5
     if (ret < 0) {
         LOG_ERROR("Listen port:%d error!", m_port);
-        close(m_listenFd);
+        close(listenFd);
         return false;
     }
 
-    /* 将m_listenFd以 EPOLLIN 和 m_listenEvent 为事件类型，注册到m_epoller中m_epollFd指示的epoll内核事件中 */
-    /* 当listen到新的客户连接时，m_listenFd变为就绪事件 */
-    ret = m_epoller->addFd(m_listenFd, m_listenEvent | EPOLLIN);
-    if (ret == 0) {
-        LOG_ERROR("Add listen error!");
-        close(m_listenFd);
-        return false;
-    }
-    
-    setFdNonblock(m_listenFd);
     LOG_INFO("Server port:%d", m_port);
     return true;
 }
-
-void WebServer::m_addClient(int connFd, sockaddr_in addr) {
-    assert(connFd > 0);
-    m_users[connFd].init(connFd, addr);
-    if (m_timeoutMS > 0) {
-        m_timer->add(connFd, m_timeoutMS, std::bind(&WebServer::m_closeConn, this, &m_users[connFd]));
-    }
-    m_epoller->addFd(connFd, EPOLLIN | m_connEvent);
-    setFdNonblock(connFd);
-    LOG_INFO("Client[%d] in!", m_users[connFd].getFd());
-}
-
-void WebServer::m_dealListen() {
-    struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    do {
-        int connFd = accept(m_listenFd, (struct sockaddr *)&addr, &len);
-        if (connFd <= 0) { return; }
-        else if (HttpConn::userCount >= MAX_FD) {
-            m_sendError(connFd, "Server busy!");
-            LOG_WARN("Clients is full!");
-            return;
-        }
-        m_addClient(connFd, addr);
-    } while (m_listenEvent & EPOLLET);
-}
-
-void WebServer::m_dealRead(HttpConn* client) {
-    assert(client);
-    m_extentTime(client);
-    m_threadpool->addTask(std::bind(&WebServer::m_onRead, this, client));
-}
-
-void WebServer::m_dealWrite(HttpConn* client) {
-    assert(client);
-    m_extentTime(client);
-    m_threadpool->addTask(std::bind(&WebServer::m_onWrite, this, client));
-}
-
-void WebServer::m_sendError(int fd, const char*info) {
-    assert(fd > 0);
-    int ret = send(fd, info, strlen(info), 0);
-    if (ret < 0) {
-        LOG_WARN("send error to client[%d] error!", fd);
-    }
-    close(fd);
-}
-
-void WebServer::m_extentTime(HttpConn* client) {
-    assert(client);
-    if (m_timeoutMS > 0) { m_timer->adjust(client->getFd(), m_timeoutMS); }
-}
-
-void WebServer::m_closeConn(HttpConn* client) {
-    assert(client);
-    LOG_INFO("Client[%d] quit!", client->getFd());
-    m_epoller->delFd(client->getFd());
-    client->closeConn();
-}
-
-void WebServer::m_onRead(HttpConn* client) {
-    assert(client);
-    int ret = -1;
-    int readErrno = 0;
-    ret = client->read(&readErrno);
-    if (ret <= 0 && readErrno != EAGAIN) {
-        m_closeConn(client);
-        return;
-    }
-    m_onProcess(client);
-}
-
-void WebServer::m_onProcess(HttpConn* client) {
-    if (client->process()) {
-        m_epoller->modFd(client->getFd(), m_connEvent | EPOLLOUT);
-    } else {
-        m_epoller->modFd(client->getFd(), m_connEvent | EPOLLIN);
-    }
-}
- 
-void WebServer::m_onWrite(HttpConn* client) {
-    assert(client);
-    int ret = -1;
-    int writeErrno = 0;
-    ret = client->write(&writeErrno);
-    if (client->toWriteBytes() == 0) {
-        /* 传输完成 */
-        if (client->isKeepAlive()) {
-            m_onProcess(client);
-            return;
-        }
-    } else if (ret < 0) {
-        if (writeErrno == EAGAIN) {
-            /* 继续传输 */
-            m_epoller->modFd(client->getFd(), m_connEvent | EPOLLOUT);
-            return;
-        }
-    }
-    m_closeConn(client);
-}
-
-int WebServer::setFdNonblock(int fd) {
-    assert(fd > 0);
-    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);    //用F_GETFL获取文件描述符旧的状态标志位，再用F_SETFL设置为新的非阻塞的状态标志位
-}
@@ -1,18 +1,19 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
-#include <unordered_map>
+#include <vector>
+#include <thread>
 #include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
 #include <errno.h>
+#include <signal.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-#include "epoller.h"
+#include "reactor.h"
 #include "../log/log.h"
-#include "../timer/heaptimer.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/threadpool.h"
 #include "../pool/sqlconnRAII.h"
@@ -20,49 +21,53 @@
 
 class WebServer {
     public:
+        enum REACTOR_MODE {
+            POOL_REACTOR = 0,   /* 单Reactor + 线程池 */
+            REUSEPORT_REACTOR,  /* 多Reactor，每个线程一个SO_REUSEPORT监听socket */
+            MAIN_SUB_REACTOR,   /* 主Reactor负责accept，经eventfd投递给从Reactor */
+        };
+
+        enum DISPATCH_POLICY {
+            ROUND_ROBIN = 0,
+            LEAST_CONN,
+        };
+
         WebServer(
             int port, int trigMode, int timeoutMS, bool optLinger,
             int sqlPort, const char* sqlUser, const  char* sqlPwd, const char* dbName,
-            int connPoolNum, int threadNum, bool openLog, int logLevel, int logQueSize);
+            int connPoolNum, int threadNum, bool openLog, int logLevel, int logQueSize,
+            int reactorMode = POOL_REACTOR, int reactorNum = 1, int dispatchPolicy = ROUND_ROBIN,
+            int pollerBackend = Poller::EPOLL, const char* packPath = nullptr);
 
         ~WebServer();
         void start();
 
     private:
         void m_initEventMode(int trigMode);
-        bool m_initSocket();
-        void m_addClient(int fd, sockaddr_in addr);
-    
-        void m_dealListen();
-        void m_dealWrite(HttpConn* client);
-        void m_dealRead(HttpConn* client);
-
-        void m_sendError(int fd, const char*info);
-        void m_extentTime(HttpConn* client);
-        void m_closeConn(HttpConn* client);
+        bool m_initReactors(int reactorNum, int threadNum);
+        bool m_initSocket(int& listenFd, bool reusePort);
 
-        void m_onRead(HttpConn* client);
-        void m_onWrite(HttpConn* client);
-        void m_onProcess(HttpConn* client);
-
-        static const int MAX_FD = 65536;
-
-        static int setFdNonblock(int fd);
+        void m_dealListen();
+        Reactor* m_nextReactor();
 
         int m_port;
         int m_timeoutMS;  /* 毫秒MS */
         bool m_openLinger;
         bool m_isClose;
-        int m_listenFd;
+        int m_reactorMode;
+        int m_dispatchPolicy;
+        int m_pollerBackend;
+        size_t m_nextIdx;
         char* m_srcDir;
 
         uint32_t m_listenEvent;
         uint32_t m_connEvent;
 
-        std::unique_ptr<HeapTimer> m_timer;
+        std::vector<int> m_listenFds;
+        std::unique_ptr<ConnTable> m_users;
+        std::unique_ptr<Poller> m_epoller;  /* 主从模式下主Reactor的epoll */
         std::unique_ptr<ThreadPool> m_threadpool;
-        std::unique_ptr<Epoller> m_epoller;
-        std::unordered_map<int, HttpConn> m_users;
+        std::vector<std::unique_ptr<Reactor>> m_reactors;
 };
 
 
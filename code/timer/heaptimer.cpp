@@ -75,12 +75,12 @@ int HeapTimer::getNextTick() {
 
 void HeapTimer::m_siftUp(size_t i) {
     assert(i >= 0 && i < m_heap.size());
-    size_t j = (i - 1) / 2;
-    while (j >= 0) {
+    /* size_t恒不小于0，以i到达堆顶为终止条件 */
+    while (i > 0) {
+        size_t j = (i - 1) / 2;
         if (m_heap[j] < m_heap[i]) { break; }
         m_swapNode(i, j);
         i = j;
-        j = (i - 1) / 2;
     }
 }
 
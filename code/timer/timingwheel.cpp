@@ -0,0 +1,190 @@
+#include "timingwheel.h"
+
+TimingWheel::TimingWheel(const ExpireCallBack& cb): m_bits(), m_current(m_nowMS()), m_count(0), m_cb(cb) {
+    for (WheelNode& head: m_buckets) {
+        head.prev = head.next = &head;
+    }
+}
+
+uint64_t TimingWheel::m_nowMS() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TimingWheel::add(WheelNode* node, int timeout, uint64_t data) {
+    assert(node && timeout >= 0);
+    if (node->linked()) {
+        m_unlink(node);
+    } else {
+        m_count++;
+    }
+    node->expires = m_nowMS() + timeout;
+    node->data = data;
+    m_link(node);
+}
+
+void TimingWheel::adjust(WheelNode* node, int timeout) {
+    assert(node && timeout >= 0);
+    if (!node->linked()) {
+        return;
+    }
+    m_unlink(node);
+    node->expires = m_nowMS() + timeout;
+    m_link(node);
+}
+
+void TimingWheel::cancel(WheelNode* node) {
+    assert(node);
+    if (node->linked()) {
+        m_unlink(node);
+        m_count--;
+    }
+}
+
+void TimingWheel::doWork(WheelNode* node) {
+    assert(node);
+    if (!node->linked()) {
+        return;
+    }
+    m_unlink(node);
+    m_count--;
+    m_cb(node->data);
+}
+
+void TimingWheel::clear() {
+    for (WheelNode& head: m_buckets) {
+        while (head.next != &head) {
+            m_unlink(head.next);
+        }
+    }
+    m_count = 0;
+}
+
+void TimingWheel::tick() {
+    uint64_t now = m_nowMS();
+    while (m_current <= now) {
+        if (m_count == 0) {
+            m_current = now + 1;
+            break;
+        }
+        size_t idx = m_current & (ROOT_SIZE - 1);
+        if (idx == 0) {
+            m_cascade();
+        }
+        m_expire(idx);
+        /* 跳过第0层本圈内的空桶，但不越过下一次级联 */
+        int dist = m_findNext(0, (idx + 1) & (ROOT_SIZE - 1));
+        uint64_t next = (m_current | (ROOT_SIZE - 1)) + 1;
+        if (dist >= 0 && static_cast<size_t>(dist) < ROOT_SIZE - 1 - idx) {
+            next = m_current + 1 + dist;
+        }
+        m_current = next < now + 1 ? next : now + 1;
+    }
+}
+
+int TimingWheel::getNextTick() {
+    tick();
+    if (m_count == 0) {
+        return -1;
+    }
+    /* 各层最早的非空桶：第0层是其到期时刻，上层是其级联时刻，取最小值作为下限 */
+    uint64_t next = UINT64_MAX;
+    for (int level = 0; level < LEVELS; level++) {
+        int shift = m_shift(level);
+        uint64_t start = ((m_current + (1ULL << shift) - 1) >> shift) << shift;
+        int dist = m_findNext(level, (start >> shift) & (m_levelSize(level) - 1));
+        if (dist >= 0 && start + (static_cast<uint64_t>(dist) << shift) < next) {
+            next = start + (static_cast<uint64_t>(dist) << shift);
+        }
+    }
+    uint64_t now = m_nowMS();
+    if (next <= now) {
+        return 0;
+    }
+    return next - now > INT_MAX ? INT_MAX : static_cast<int>(next - now);
+}
+
+void TimingWheel::m_link(WheelNode* node) {
+    /* 按距当前时刻的远近选层，超出范围的先放在最高层，到期时再按真实时间重新放置 */
+    uint64_t expires = node->expires > m_current ? node->expires : m_current;
+    uint64_t delta = expires - m_current;
+    if (delta >= MAX_SPAN) {
+        expires = m_current + MAX_SPAN - 1;
+        delta = MAX_SPAN - 1;
+    }
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ULL << m_shift(level + 1))) {
+        level++;
+    }
+    size_t bucket = m_levelBase(level) + ((expires >> m_shift(level)) & (m_levelSize(level) - 1));
+    WheelNode* head = &m_buckets[bucket];
+    node->bucket = bucket;
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+    m_bits[bucket / 64] |= 1ULL << (bucket % 64);
+}
+
+void TimingWheel::m_unlink(WheelNode* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = nullptr;
+    WheelNode* head = &m_buckets[node->bucket];
+    if (head->next == head) {
+        m_bits[node->bucket / 64] &= ~(1ULL << (node->bucket % 64));
+    }
+}
+
+void TimingWheel::m_cascade() {
+    /* 第0层转完一圈，上一层当前桶的结点下移；该层也转完一圈时继续向上 */
+    for (int level = 1; level < LEVELS; level++) {
+        size_t idx = (m_current >> m_shift(level)) & (LEVEL_SIZE - 1);
+        WheelNode* head = &m_buckets[m_levelBase(level) + idx];
+        while (head->next != head) {
+            WheelNode* node = head->next;
+            m_unlink(node);
+            m_link(node);
+        }
+        if (idx != 0) {
+            break;
+        }
+    }
+}
+
+void TimingWheel::m_expire(size_t bucket) {
+    /* 逐个取下再回调，回调中增删其他结点不影响遍历 */
+    WheelNode* head = &m_buckets[bucket];
+    while (head->next != head) {
+        WheelNode* node = head->next;
+        m_unlink(node);
+        if (node->expires > m_current) {
+            /* 超出范围时放在最高层的结点，尚未真正到期 */
+            m_link(node);
+            continue;
+        }
+        m_count--;
+        m_cb(node->data);
+    }
+}
+
+int TimingWheel::m_findNext(int level, size_t idx) const {
+    /* 从idx起按环形顺序找第一个非空桶，返回与idx的距离，全空时返回-1 */
+    size_t size = m_levelSize(level);
+    size_t words = size / 64;
+    const uint64_t* bits = m_bits + m_levelBase(level) / 64;
+    for (size_t i = 0; i <= words; i++) {
+        size_t w = (idx / 64 + i) % words;
+        uint64_t word = bits[w];
+        if (i == 0) {
+            word &= ~0ULL << (idx % 64);
+        } else if (i == words) {
+            word &= ~(~0ULL << (idx % 64));
+        }
+        if (word) {
+            size_t pos = w * 64 + __builtin_ctzll(word);
+            return (pos + size - idx) % size;
+        }
+    }
+    return -1;
+}
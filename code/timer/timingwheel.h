@@ -0,0 +1,87 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <functional>
+#include <assert.h>
+#include <stdint.h>
+#include <limits.h>
+#include <chrono>
+
+/* 侵入式定时结点，由使用者嵌在自己的数据结构中（如连接槽位），时间轮只串链表不分配内存 */
+struct WheelNode {
+    WheelNode* prev = nullptr;
+    WheelNode* next = nullptr;
+    uint64_t expires = 0;   /* 到期时刻，毫秒 */
+    uint64_t data = 0;      /* 到期时传给回调 */
+    uint32_t bucket = 0;
+
+    bool linked() const { return prev != nullptr; }
+};
+
+/*
+ * 分层时间轮，毫秒精度：第0层256个桶每桶1ms，其上3层各64个桶，每层粒度是下一层的一整圈，
+ * 覆盖约18.6小时，更远的到期时间先挂在最高层，转到时再重新放置
+ * 添加、调整、取消都是O(1)的链表操作；上层的桶在第0层转完一圈时整体下移（级联）
+ * 回调在构造时给定一次，每个结点只带一个uint64_t参数，add时不再构造std::function
+ * 非线程安全，只能在所属的事件循环线程上使用；结点释放前须先cancel，或比时间轮活得更久
+ */
+class TimingWheel {
+    public:
+        typedef std::function<void(uint64_t)> ExpireCallBack;
+
+        explicit TimingWheel(const ExpireCallBack& cb);
+
+        ~TimingWheel() { clear(); }
+
+        /* 结点已在轮中时改为新的到期时间和参数 */
+        void add(WheelNode* node, int timeout, uint64_t data);
+
+        /* 结点已到期或已取消时不做处理 */
+        void adjust(WheelNode* node, int timeout);
+
+        void cancel(WheelNode* node);
+
+        /* 取下结点并立即触发回调 */
+        void doWork(WheelNode* node);
+
+        void clear();
+
+        void tick();
+
+        /* 距下一个结点到期或下一次级联的毫秒数，没有结点时返回-1 */
+        int getNextTick();
+
+        size_t size() const { return m_count; }
+
+    private:
+        static const int LEVELS = 4;
+        static const int ROOT_BITS = 8;
+        static const int LEVEL_BITS = 6;
+        static const size_t ROOT_SIZE = 1 << ROOT_BITS;
+        static const size_t LEVEL_SIZE = 1 << LEVEL_BITS;
+        static const size_t BUCKET_COUNT = ROOT_SIZE + (LEVELS - 1) * LEVEL_SIZE;
+        static const uint64_t MAX_SPAN = 1ULL << (ROOT_BITS + (LEVELS - 1) * LEVEL_BITS);
+
+        static uint64_t m_nowMS();
+
+        static int m_shift(int level) { return level == 0 ? 0 : ROOT_BITS + (level - 1) * LEVEL_BITS; }
+        static size_t m_levelBase(int level) { return level == 0 ? 0 : ROOT_SIZE + (level - 1) * LEVEL_SIZE; }
+        static size_t m_levelSize(int level) { return level == 0 ? ROOT_SIZE : LEVEL_SIZE; }
+
+        void m_link(WheelNode* node);
+        void m_unlink(WheelNode* node);
+        void m_cascade();
+        void m_expire(size_t bucket);
+        int m_findNext(int level, size_t idx) const;
+
+        /* 每个桶是以哨兵结点为头的循环双向链表，位图标记非空的桶 */
+        WheelNode m_buckets[BUCKET_COUNT];
+        uint64_t m_bits[BUCKET_COUNT / 64];
+
+        /* 下一个尚未处理的毫秒 */
+        uint64_t m_current;
+        size_t m_count;
+        ExpireCallBack m_cb;
+};
+
+#endif  //TIMING_WHEEL_H
@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include "../http/assetpack.h"
+
+/*
+ * 把资源目录打成资源包：mkpack <资源目录> <输出文件>
+ * 输出先写临时文件再rename，可以直接覆盖正在被服务进程使用的包
+ */
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <resources dir> <pack file>\n", argv[0]);
+        return 1;
+    }
+    if (!AssetPack::build(argv[1], argv[2])) {
+        fprintf(stderr, "mkpack: build %s from %s failed\n", argv[2], argv[1]);
+        return 1;
+    }
+    std::shared_ptr<AssetPack> pack = AssetPack::open(argv[2]);
+    if (!pack) {
+        fprintf(stderr, "mkpack: %s is unreadable after build\n", argv[2]);
+        return 1;
+    }
+    printf("%s: %zu files\n", argv[2], pack->count());
+    return 0;
+}
@@ -0,0 +1,449 @@
+#include <atomic>
+#include <chrono>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "../code/buffer/buffer.h"
+#include "../code/http/httprequest.h"
+#include "../code/timer/heaptimer.h"
+#include "../code/timer/timingwheel.h"
+
+typedef std::chrono::steady_clock BenchClock;
+
+/* 原基于 std::regex 的请求行与首部解析，作为对照 */
+class RegexRequest {
+    public:
+        bool parse(Buffer& buff) {
+            const char CRLF[] = "\r\n";
+            int state = 0;
+            while (buff.readableBytes() && state != 2) {
+                const char* lineEnd = std::search(buff.peek(), buff.beginWriteConst(), CRLF, CRLF + 2);
+                std::string line(buff.peek(), lineEnd);
+                if (state == 0) {
+                    std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
+                    std::smatch subMatch;
+                    if (!std::regex_match(line, subMatch, patten)) { return false; }
+                    method = subMatch[1];
+                    path = subMatch[2];
+                    version = subMatch[3];
+                    state = 1;
+                } else {
+                    std::regex patten("^([^:]*): ?(.*)$");
+                    std::smatch subMatch;
+                    if (std::regex_match(line, subMatch, patten)) {
+                        header[subMatch[1]] = subMatch[2];
+                    }
+                    if (buff.readableBytes() <= 2) { state = 2; }
+                }
+                if (lineEnd == buff.beginWrite()) { break; }
+                buff.retrieveUntil(lineEnd + 2);
+            }
+            return true;
+        }
+
+        std::string method, path, version;
+        std::unordered_map<std::string, std::string> header;
+};
+
+static std::vector<std::string> MakeRequests() {
+    const char* urls[] = {
+        "/", "/index.html", "/picture", "/video", "/login",
+        "/css/bootstrap.min.css", "/css/animate.css", "/css/font-awesome.min.css",
+        "/js/jquery.js", "/js/bootstrap.min.js", "/js/custom.js",
+        "/images/profile-image.jpg", "/images/instagram-image1.jpg", "/images/favicon.ico",
+        "/fonts/fontawesome-webfont.woff2", "/fonts/fontawesome-webfont.svg",
+    };
+    std::vector<std::string> reqs;
+    for (const char* url: urls) {
+        std::string req = std::string("GET ") + url + " HTTP/1.1\r\n";
+        req += "Host: 127.0.0.1:8088\r\n";
+        req += "Connection: keep-alive\r\n";
+        req += "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n";
+        req += "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n";
+        req += "Accept-Encoding: gzip, deflate, br\r\n";
+        req += "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n";
+        req += "Referer: http://127.0.0.1:8088/index.html\r\n";
+        req += "Cache-Control: max-age=0\r\n";
+        req += "\r\n";
+        reqs.push_back(req);
+    }
+    return reqs;
+}
+
+template<class F>
+static double RunBench(const char* name, const std::vector<std::string>& reqs, int rounds, F parseOne) {
+    Buffer buff(4096);
+    size_t ok = 0;
+    auto start = BenchClock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (auto& req: reqs) {
+            buff.append(req);
+            ok += parseOne(buff);
+            buff.retrieveAll();
+        }
+    }
+    double sec = std::chrono::duration<double>(BenchClock::now() - start).count();
+    double rps = ok / sec;
+    printf("%-24s %10zu requests  %8.3f s  %12.0f req/s\n", name, ok, sec, rps);
+    return rps;
+}
+
+void BenchParser(int rounds) {
+    std::vector<std::string> reqs = MakeRequests();
+    printf("== request parser: %zu resources/ URLs x %d rounds (single core) ==\n", reqs.size(), rounds);
+    double oldRps = RunBench("std::regex parser", reqs, rounds / 100 + 1, [](Buffer& buff) {
+        RegexRequest req;
+        return req.parse(buff) ? 1 : 0;
+    });
+    HttpRequest request;
+    double newRps = RunBench("state machine parser", reqs, rounds, [&request](Buffer& buff) {
+        request.init();
+        return request.parse(buff) == HttpRequest::GET_REQUEST ? 1 : 0;
+    });
+    printf("speedup: %.1fx\n\n", newRps / oldRps);
+}
+
+/* 原先的缓冲区：vector存储、原子的读写位置、readFd在栈上开64KB溢出区、retrieveAll清零整块，作为对照 */
+class OldBuffer {
+    public:
+        OldBuffer(int initBuffSize = 1024): m_buffer(initBuffSize), m_readPos(0), m_writePos(0) {}
+
+        size_t readableBytes() const { return m_writePos - m_readPos; }
+        size_t writableBytes() const { return m_buffer.size() - m_writePos; }
+        const char* peek() const { return &m_buffer[0] + m_readPos; }
+        void retrieve(size_t len) { m_readPos += len; }
+        void retrieveAll() {
+            bzero(&m_buffer[0], m_buffer.size());
+            m_readPos = 0;
+            m_writePos = 0;
+        }
+        void append(const char* str, size_t len) {
+            if (writableBytes() < len) { m_makeSpace(len); }
+            std::copy(str, str + len, &m_buffer[0] + m_writePos);
+            m_writePos += len;
+        }
+        ssize_t readFd(int fd, int* saveErrno) {
+            char buff[65535];
+            struct iovec iov[2];
+            const size_t writable = writableBytes();
+            iov[0].iov_base = &m_buffer[0] + m_writePos;
+            iov[0].iov_len = writable;
+            iov[1].iov_base = buff;
+            iov[1].iov_len = sizeof(buff);
+            const ssize_t len = readv(fd, iov, 2);
+            if (len < 0) {
+                *saveErrno = errno;
+            } else if (static_cast<size_t>(len) <= writable) {
+                m_writePos += len;
+            } else {
+                m_writePos = m_buffer.size();
+                append(buff, len - writable);
+            }
+            return len;
+        }
+
+    private:
+        void m_makeSpace(size_t len) {
+            if (writableBytes() + m_readPos < len) {
+                m_buffer.resize(m_writePos + len + 1);
+            } else {
+                size_t readable = readableBytes();
+                std::copy(&m_buffer[0] + m_readPos, &m_buffer[0] + m_writePos, &m_buffer[0]);
+                m_readPos = 0;
+                m_writePos = readable;
+            }
+        }
+
+        std::vector<char> m_buffer;
+        std::atomic<std::size_t> m_readPos;
+        std::atomic<std::size_t> m_writePos;
+};
+
+/* 模拟生成响应头：小段追加，再按段取走 */
+template<class B>
+static size_t AppendRetrieve(B& buff, int rounds) {
+    static const char* FIELDS[] = {
+        "HTTP/1.1 200 OK\r\n", "Server: WebServer\r\n", "Connection: keep-alive\r\n",
+        "Keep-Alive: max=6, timeout=120\r\n", "Content-type: text/html\r\n", "Content-length: 3214\r\n\r\n",
+    };
+    size_t bytes = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (int k = 0; k < 4; k++) {
+            for (const char* field: FIELDS) { buff.append(field, strlen(field)); }
+        }
+        while (buff.readableBytes() > 0) {
+            size_t n = std::min<size_t>(buff.readableBytes(), 64);
+            bytes += n + (buff.peek()[0] == 'H');
+            buff.retrieve(n);
+        }
+        buff.retrieveAll();
+    }
+    return bytes;
+}
+
+/* 从socketpair读入chunk字节，取完后清空 */
+template<class B>
+static size_t ReadChunks(B& buff, int rounds, size_t chunk) {
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    int sndbuf = 4 * 1024 * 1024;
+    setsockopt(sv[1], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    setsockopt(sv[0], SOL_SOCKET, SO_RCVBUF, &sndbuf, sizeof(sndbuf));
+    std::string data(chunk, 'r');
+    size_t bytes = 0;
+    int err = 0;
+    for (int r = 0; r < rounds; r++) {
+        ssize_t ret = write(sv[1], data.data(), data.size());
+        (void)ret;
+        size_t got = 0;
+        while (got < chunk) {
+            ssize_t n = buff.readFd(sv[0], &err);
+            if (n <= 0) { break; }
+            got += n;
+        }
+        bytes += buff.readableBytes();
+        buff.retrieveAll();
+    }
+    close(sv[0]);
+    close(sv[1]);
+    return bytes;
+}
+
+template<class F>
+static double TimeIt(const char* name, F run) {
+    auto start = BenchClock::now();
+    size_t bytes = run();
+    double sec = std::chrono::duration<double>(BenchClock::now() - start).count();
+    printf("%-32s %8.3f s  %10.1f MB/s\n", name, sec, bytes / sec / 1e6);
+    return sec;
+}
+
+void BenchBuffer(int rounds) {
+    printf("== buffer: append/retrieve and readFd x %d rounds (single core) ==\n", rounds);
+    OldBuffer oldBuff;
+    Buffer newBuff;
+    double oldSec = TimeIt("old append/retrieve", [&] { return AppendRetrieve(oldBuff, rounds * 10); });
+    double newSec = TimeIt("new append/retrieve", [&] { return AppendRetrieve(newBuff, rounds * 10); });
+    printf("speedup: %.2fx\n", oldSec / newSec);
+    for (size_t chunk: { (size_t)512, (size_t)16 * 1024, (size_t)256 * 1024 }) {
+        char oldName[64], newName[64];
+        snprintf(oldName, sizeof(oldName), "old readFd %zuB", chunk);
+        snprintf(newName, sizeof(newName), "new readFd %zuB", chunk);
+        int n = chunk > 64 * 1024 ? rounds / 20 + 1 : rounds;
+        oldSec = TimeIt(oldName, [&] { return ReadChunks(oldBuff, n, chunk); });
+        newSec = TimeIt(newName, [&] { return ReadChunks(newBuff, n, chunk); });
+        printf("speedup: %.2fx\n", oldSec / newSec);
+    }
+    printf("\n");
+}
+
+/* 回环TCP连接，另一端由线程读出丢弃 */
+static int ConnectDrain(std::thread& drain) {
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    bind(listenFd, (struct sockaddr*)&addr, addrLen);
+    listen(listenFd, 1);
+    getsockname(listenFd, (struct sockaddr*)&addr, &addrLen);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    connect(fd, (struct sockaddr*)&addr, addrLen);
+    int peer = accept(listenFd, nullptr, nullptr);
+    close(listenFd);
+    drain = std::thread([peer] {
+        static char buf[256 * 1024];
+        while (read(peer, buf, sizeof(buf)) > 0) {}
+        close(peer);
+    });
+    return fd;
+}
+
+static std::vector<std::string> ListFiles(const std::vector<std::string>& dirs) {
+    std::vector<std::string> files;
+    for (auto& dir: dirs) {
+        DIR* dp = opendir(dir.c_str());
+        if (!dp) { continue; }
+        while (struct dirent* ent = readdir(dp)) {
+            if (ent->d_name[0] != '.') { files.push_back(dir + "/" + ent->d_name); }
+        }
+        closedir(dp);
+    }
+    return files;
+}
+
+/* 与HttpResponse/HttpConn相同的两种发送方式：每次请求 open+mmap+writev+munmap，或 open+send(MSG_MORE)+sendfile */
+static size_t SendMmap(int sock, const std::string& path, const std::string& head) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    void* file = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    struct iovec iov[2] = { { (void*)head.data(), head.size() }, { file, (size_t)st.st_size } };
+    size_t total = head.size() + st.st_size, sent = 0;
+    while (sent < total) {
+        ssize_t n = writev(sock, iov, 2);
+        if (n <= 0) { break; }
+        sent += n;
+        for (auto& v: iov) {
+            size_t k = std::min((size_t)n, v.iov_len);
+            v.iov_base = (char*)v.iov_base + k;
+            v.iov_len -= k;
+            n -= k;
+        }
+    }
+    munmap(file, st.st_size);
+    return sent;
+}
+
+static size_t SendFile(int sock, const std::string& path, const std::string& head) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    size_t sent = send(sock, head.data(), head.size(), MSG_MORE);
+    off_t off = 0;
+    while (off < st.st_size) {
+        ssize_t n = sendfile(sock, fd, &off, st.st_size - off);
+        if (n <= 0) { break; }
+        sent += n;
+    }
+    close(fd);
+    return sent;
+}
+
+template<class F>
+static void RunSend(const char* name, const std::vector<std::string>& files, int rounds, F sendOne) {
+    std::string head = "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\nContent-type: image/jpeg\r\nContent-length: 0\r\n\r\n";
+    std::thread drain;
+    int sock = ConnectDrain(drain);
+    size_t bytes = 0, reqs = 0;
+    auto start = BenchClock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (auto& file: files) {
+            bytes += sendOne(sock, file, head);
+            reqs++;
+        }
+    }
+    double sec = std::chrono::duration<double>(BenchClock::now() - start).count();
+    shutdown(sock, SHUT_WR);
+    drain.join();
+    close(sock);
+    printf("%-24s %10zu responses %8.3f s  %10.0f resp/s  %8.1f MB/s\n", name, reqs, sec, reqs / sec, bytes / sec / 1e6);
+}
+
+void BenchSendfile(int rounds) {
+    for (const char* dir: { "../resources/images", "../resources/fonts" }) {
+        std::vector<std::string> files = ListFiles({ dir });
+        if (files.empty()) { continue; }
+        printf("== static file send: %s (%zu files) x %d rounds, loopback TCP ==\n", dir, files.size(), rounds);
+        RunSend("mmap + writev", files, rounds, SendMmap);
+        RunSend("sendfile + MSG_MORE", files, rounds, SendFile);
+        printf("\n");
+    }
+}
+
+/* 与Reactor相同的用法：超时回调凭连接key关闭连接，这里只计数 */
+struct ExpireCounter {
+    size_t fired = 0;
+    void onExpire(uint64_t key) { fired += key != 0; }
+};
+
+static double NsPerOp(size_t ops, BenchClock::time_point start) {
+    return std::chrono::duration<double, std::nano>(BenchClock::now() - start).count() / ops;
+}
+
+static void PrintTimer(const char* op, double heapNs, double wheelNs) {
+    printf("%-24s %10.1f ns %10.1f ns  %6.2fx\n", op, heapNs, wheelNs, heapNs / wheelNs);
+}
+
+void BenchTimer(int rounds) {
+    size_t ops = static_cast<size_t>(rounds) * 50;
+    printf("== timer: HeapTimer vs TimingWheel, %zu adjusts per size (single core) ==\n", ops);
+    for (size_t n: { (size_t)10000, (size_t)100000, (size_t)1000000 }) {
+        std::vector<int> ids(ops);
+        unsigned seed = 12345;
+        for (int& id: ids) { id = (seed = seed * 1103515245 + 12345) % n; }
+        ExpireCounter heapCnt, wheelCnt;
+        HeapTimer heap;
+        std::vector<WheelNode> nodes(n);
+        TimingWheel wheel([&wheelCnt](uint64_t key) { wheelCnt.onExpire(key); });
+        printf("-- %zu timers --%*s %13s %13s\n", n, n < 100000 ? 9 : n < 1000000 ? 8 : 7, "", "HeapTimer", "TimingWheel");
+
+        /* 添加：连接建立时，超时时间与main.cpp中的默认值相当 */
+        auto start = BenchClock::now();
+        for (size_t i = 0; i < n; i++) {
+            heap.add(i, 60000 + i % 1000, std::bind(&ExpireCounter::onExpire, &heapCnt, i + 1));
+        }
+        double heapNs = NsPerOp(n, start);
+        start = BenchClock::now();
+        for (size_t i = 0; i < n; i++) {
+            wheel.add(&nodes[i], 60000 + i % 1000, i + 1);
+        }
+        PrintTimer("add", heapNs, NsPerOp(n, start));
+
+        /* 刷新：每次读写事件推迟随机一个连接的超时 */
+        start = BenchClock::now();
+        for (int id: ids) { heap.adjust(id, 60000); }
+        heapNs = NsPerOp(ops, start);
+        start = BenchClock::now();
+        for (int id: ids) { wheel.adjust(&nodes[id], 60000); }
+        PrintTimer("adjust", heapNs, NsPerOp(ops, start));
+
+        /* 取下并回调：连接关闭时 */
+        start = BenchClock::now();
+        for (size_t i = 0; i < n; i++) { heap.doWork(i); }
+        heapNs = NsPerOp(n, start);
+        start = BenchClock::now();
+        for (size_t i = 0; i < n; i++) { wheel.doWork(&nodes[i]); }
+        PrintTimer("doWork", heapNs, NsPerOp(n, start));
+
+        /* 到期：全部在20ms内到期，等待后由getNextTick一次处理完 */
+        for (size_t i = 0; i < n; i++) {
+            heap.add(i, i % 20, std::bind(&ExpireCounter::onExpire, &heapCnt, i + 1));
+            wheel.add(&nodes[i], i % 20, i + 1);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        start = BenchClock::now();
+        int heapNext = heap.getNextTick();
+        heapNs = NsPerOp(n, start);
+        start = BenchClock::now();
+        int wheelNext = wheel.getNextTick();
+        PrintTimer("expire", heapNs, NsPerOp(n, start));
+        if (heapNext != -1 || wheelNext != -1 || heapCnt.fired != 2 * n || wheelCnt.fired != 2 * n) {
+            printf("timer mismatch: heap fired %zu, wheel fired %zu\n", heapCnt.fired, wheelCnt.fired);
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    const char* which = argc > 1 ? argv[1] : "all";
+    int rounds = argc > 2 ? atoi(argv[2]) : 20000;
+    if (!strcmp(which, "all") || !strcmp(which, "parser")) {
+        BenchParser(rounds);
+    }
+    if (!strcmp(which, "all") || !strcmp(which, "buffer")) {
+        BenchBuffer(rounds);
+    }
+    if (!strcmp(which, "all") || !strcmp(which, "sendfile")) {
+        BenchSendfile(rounds / 10 + 1);
+    }
+    if (!strcmp(which, "all") || !strcmp(which, "timer")) {
+        BenchTimer(rounds);
+    }
+}
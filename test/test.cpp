@@ -3,7 +3,18 @@
 #define gettid() syscall(SYS_gettid)
 
 #include "../code/log/log.h"
+#include "../code/buffer/chainbuffer.h"
 #include "../code/pool/threadpool.h"
+#include "../code/http/httprequest.h"
+#include "../code/http/filecache.h"
+#include "../code/http/assetpack.h"
+#include "../code/http/httpresponse.h"
+#include "../code/http/httpconn.h"
+#include "../code/timer/timingwheel.h"
+#include "../code/server/uringpoller.h"
+#include "../code/server/conntable.h"
+#include "../code/server/lockfreequeue.h"
+#include "../code/server/reactor.h"
 
 void TestLog() {
     int cnt = 0, level = 0;
@@ -43,7 +54,1166 @@ void TestThreadPool() {
     getchar();
 }
 
+void TestHttpRequest() {
+    struct Case {
+        const char* raw;
+        bool ok;
+        const char* path;
+        bool keepAlive;
+    } cases[] = {
+        { "GET / HTTP/1.1\r\nHost: a\r\n\r\n", true, "/index.html", true },
+        { "GET /video HTTP/1.1\r\nHost: a\r\nConnection: close\r\n\r\n", true, "/video.html", false },
+        { "GET /css/style.css HTTP/1.0\r\nconnection: Keep-Alive\r\n\r\n", true, "/css/style.css", true },
+        { "GET /x HTTP/1.1\nHost: a\n\n", true, "/x", true },
+        { "GET /x HTTP/1.1\r\n\r\n", false, "", false },                          /* 缺少Host */
+        { "GET /x HTTP/1.1\r\nHost : a\r\n\r\n", false, "", false },            /* 字段名后有空白 */
+        { "GET /x HTTP/1.1\r\nHost: a\r\n folded\r\n\r\n", false, "", false }, /* obs-fold */
+        { "GET  /x HTTP/1.1\r\nHost: a\r\n\r\n", false, "", false },
+        { "GET /x HTTP/11\r\nHost: a\r\n\r\n", false, "", false },
+    };
+    for (auto& c: cases) {
+        /* 逐字节喂入，模拟请求被拆分到多次读 */
+        for (size_t step: { strlen(c.raw), (size_t)1 }) {
+            Buffer buff(8);
+            HttpRequest request;
+            HttpRequest::HTTP_CODE ret = HttpRequest::NO_REQUEST;
+            for (size_t i = 0; i < strlen(c.raw) && ret == HttpRequest::NO_REQUEST; i += step) {
+                buff.append(c.raw + i, std::min(step, strlen(c.raw) - i));
+                ret = request.parse(buff);
+            }
+            assert((ret == HttpRequest::GET_REQUEST) == c.ok);
+            assert(ret != HttpRequest::NO_REQUEST);
+            if (c.ok) {
+                assert(request.path() == c.path);
+                assert(request.isKeepAlive() == c.keepAlive);
+                assert(buff.readableBytes() == 0);
+            }
+        }
+    }
+    /* 常用首部按ID查找不区分大小写，超出内联容量的首部依然可查 */
+    assert(HttpRequest::headerId("content-LENGTH") == HttpRequest::HDR_CONTENT_LENGTH);
+    assert(HttpRequest::headerId("If-Range") == HttpRequest::HDR_IF_RANGE);
+    assert(HttpRequest::headerId("X-Range") == HttpRequest::HDR_OTHER);
+    std::string many = "GET / HTTP/1.1\r\n";
+    for (int k = 0; k < 40; k++) {
+        many += "X-H" + std::to_string(k) + ": " + std::to_string(k) + "\r\n";
+    }
+    many += "RANGE: bytes=0-1\r\nHost: a\r\n\r\n";
+    Buffer manyBuff;
+    HttpRequest manyReq;
+    manyBuff.append(many);
+    assert(manyReq.parse(manyBuff) == HttpRequest::GET_REQUEST);
+    assert(manyReq.getHeader(HttpRequest::HDR_RANGE) == "bytes=0-1");
+    assert(manyReq.getHeader("x-h3") == "3" && manyReq.getHeader("X-H39") == "39");
+    assert(manyReq.getHeader(HttpRequest::HDR_IF_NONE_MATCH).data() == nullptr);
+
+    /* 报文体按Content-Length等待完整 */
+    const char* post = "POST /x HTTP/1.1\r\nHost: a\r\nContent-Length: 5\r\n\r\nab";
+    Buffer buff;
+    HttpRequest request;
+    buff.append(post, strlen(post));
+    assert(request.parse(buff) == HttpRequest::NO_REQUEST);
+    buff.append("cdeGET", 6);
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST);
+    assert(request.body() == "abcde");
+    assert(buff.readableBytes() == 3);
+
+    /* chunked报文体，逐字节喂入，后面紧跟下一个流水线请求 */
+    const char* chunked = "POST /x HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n"
+                          "5;ext=1\r\nhello\r\nB\r\n, world!!!!\r\n0\r\nX-Trailer: t\r\n\r\nGET / HTTP/1.1\r\n";
+    Buffer chunkBuff(8);
+    HttpRequest chunkReq;
+    HttpRequest::HTTP_CODE ret = HttpRequest::NO_REQUEST;
+    size_t i = 0;
+    for (; i < strlen(chunked) && ret == HttpRequest::NO_REQUEST; i++) {
+        chunkBuff.append(chunked + i, 1);
+        ret = chunkReq.parse(chunkBuff);
+    }
+    assert(ret == HttpRequest::GET_REQUEST);
+    assert(chunkReq.body() == "hello, world!!!!");
+    assert(std::string(chunked + i) == "GET / HTTP/1.1\r\n");
+
+    /* 报文体收到即移入body()，读缓冲区中只保留首部 */
+    Buffer streamBuff;
+    HttpRequest streamReq;
+    const char* head = "POST /upload HTTP/1.1\r\nHost: a\r\nContent-Length: 100000\r\n\r\n";
+    streamBuff.append(head, strlen(head));
+    std::string part(1000, 'x');
+    for (int k = 0; k < 100; k++) {
+        assert(streamReq.parse(streamBuff) == HttpRequest::NO_REQUEST);
+        assert(streamBuff.readableBytes() == strlen(head));
+        streamBuff.append(part);
+    }
+    assert(streamReq.parse(streamBuff) == HttpRequest::GET_REQUEST);
+    assert(streamReq.body() == std::string(100000, 'x') && streamBuff.readableBytes() == 0);
+
+    /* 超出上限在接收报文体之前就拒绝；TE与CL同时出现按请求走私拒绝 */
+    struct {
+        const char* raw;
+        HttpRequest::HTTP_CODE code;
+    } bad[] = {
+        { "POST /x HTTP/1.1\r\nHost: a\r\nContent-Length: 99999999\r\n\r\n", HttpRequest::PAYLOAD_TOO_LARGE },
+        { "POST /x HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\nFFFFFFFFFFFFFFFFFFFF\r\n", HttpRequest::PAYLOAD_TOO_LARGE },
+        { "POST /x HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\nContent-Length: 3\r\n\r\n", HttpRequest::BAD_REQUEST },
+        { "POST /x HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: gzip\r\n\r\n", HttpRequest::BAD_REQUEST },
+        { "POST /x HTTP/1.1\r\nHost: a\r\nContent-Length: 3\r\nContent-Length: 3\r\n\r\n", HttpRequest::BAD_REQUEST },
+        { "POST /x HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n", HttpRequest::BAD_REQUEST },
+    };
+    for (auto& c: bad) {
+        Buffer badBuff;
+        HttpRequest badReq;
+        badBuff.append(c.raw, strlen(c.raw));
+        assert(badReq.parse(badBuff) == c.code);
+        assert(!badReq.isKeepAlive());
+    }
+}
+
+static void WriteFile(const std::string& path, const std::string& content) {
+    FILE* fp = fopen(path.c_str(), "w");
+    assert(fp);
+    fwrite(content.data(), 1, content.size(), fp);
+    fclose(fp);
+}
+
+template<class F>
+static bool WaitUntil(F cond) {
+    for (int i = 0; i < 200 && !cond(); i++) { usleep(5000); }
+    return cond();
+}
+
+/* 按HttpConn的方式把写缓冲区中的首部与报文体各段拼成完整的响应 */
+static std::string Assemble(const HttpResponse& response, const Buffer& buff) {
+    std::string out;
+    size_t begin = 0;
+    for (auto& part: response.parts()) {
+        out.append(buff.peek() + begin, part.headEnd - begin);
+        begin = part.headEnd;
+        std::string data(part.len, '\0');
+        if (response.fileFd() >= 0) {
+            assert(pread(response.fileFd(), &data[0], part.len, part.off) == (ssize_t)part.len);
+        } else {
+            data.assign(response.file() + part.off, part.len);
+        }
+        out += data;
+    }
+    out.append(buff.peek() + begin, buff.readableBytes() - begin);
+    return out;
+}
+
+/* 按HttpConn的方式生成一个响应并拼成完整的报文 */
+static std::string Render(HttpResponse& response, const std::string& root, std::string path,
+                          HttpResponse::RequestHeaders headers = {}, bool isKeepAlive = true, int code = 200) {
+    Buffer buff;
+    response.init(root, path, isKeepAlive, code, headers);
+    response.makeResponse(buff);
+    return Assemble(response, buff);
+}
+
+/* FileCache与ResponseCache是单例，只能初始化一次，各缓存相关的测试共用这个资源目录，用到的文件各自创建和删除 */
+static const std::string& CacheRoot() {
+    static std::string root;
+    if (root.empty()) {
+        char dir[] = "/tmp/filecacheXXXXXX";
+        assert(mkdtemp(dir));
+        root = dir;
+        FileCache::getInstance()->init(root, 1024 * 1024, 16, 1);
+        ResponseCache::getInstance()->init();
+    }
+    return root;
+}
+
+void TestFileCache() {
+    const std::string& root = CacheRoot();
+    std::string path = root + "/a.txt";
+    WriteFile(path, "hello");
+    FileCache* cache = FileCache::getInstance();
+
+    /* 重复的'/'与inotify上报的路径归一 */
+    std::shared_ptr<const FileEntry> e1 = cache->get(root + "//a.txt");
+    assert(e1->exists && std::string(e1->data, e1->st.st_size) == "hello");
+    assert(cache->get(path) == e1);
+
+    /* 文件修改后条目失效，旧条目在引用释放前依然可用 */
+    WriteFile(path, "world!");
+    assert(WaitUntil([&] { return cache->get(path) != e1; }));
+    assert(std::string(cache->get(path)->data, 6) == "world!");
+    assert(std::string(e1->data, e1->st.st_size) == "hello");
+
+    /* 不存在的文件同样缓存，创建后失效 */
+    std::string missing = root + "/b.txt";
+    assert(!cache->get(missing)->exists);
+    WriteFile(missing, "b");
+    assert(WaitUntil([&] { return cache->get(missing)->exists; }));
+
+    /* 条目数受上限约束 */
+    for (int i = 0; i < 40; i++) {
+        std::string name = root + "/f" + std::to_string(i);
+        WriteFile(name, "x");
+        cache->get(name);
+        unlink(name.c_str());
+    }
+    assert(cache->size() <= 17);
+    unlink(path.c_str());
+    unlink(missing.c_str());
+}
+
+void TestResponseCache() {
+    /* 整条响应缓存：按长连接与否分别缓存，文件变化后重新渲染 */
+    const std::string& root = CacheRoot();
+    FileCache* cache = FileCache::getInstance();
+    ResponseCache* responses = ResponseCache::getInstance();
+    std::string page = "/page.html";
+    WriteFile(root + page, "<p>1</p>");
+    HttpResponse response;
+    auto render = [&](bool keepAlive) { return Render(response, root, page, {}, keepAlive); };
+    std::string r1 = render(true);
+    assert(r1.find("HTTP/1.1 200 OK\r\nServer: WebServer\r\nConnection: keep-alive\r\n") == 0);
+    assert(r1.find("timeout=120\r\nDate: ") != std::string::npos && HttpDate::header().size() == 37);
+    assert(r1.compare(r1.size() - 8, 8, "<p>1</p>") == 0);
+    uint64_t hits = responses->hits();
+    /* 缓存的响应中只有Date随时间变化，长度不变 */
+    assert(render(true).size() == r1.size() && responses->hits() == hits + 1);
+    assert(render(false).find("Connection: close") != std::string::npos);
+    /* HEAD同样使用缓存的响应，只发送到报文体之前 */
+    Buffer headBuff;
+    response.init(root, page, true, 200);
+    response.makeResponse(headBuff, true);
+    std::string headOnly = Assemble(response, headBuff);
+    assert(responses->hits() == hits + 2 && headOnly.size() == r1.size() - 8);
+    assert(headOnly.compare(headOnly.size() - 4, 4, "\r\n\r\n") == 0 && headOnly.find("Content-length: 8\r\n") != std::string::npos);
+    WriteFile(root + page, "<p>2</p>");
+    assert(WaitUntil([&] { return render(true).find("<p>2</p>") != std::string::npos; }));
+    /* 文件条目先被FileCache淘汰、之后文件才变化时不会被标记stale，缓存的响应同样要作废 */
+    usleep(50 * 1000);  /* 一次写入产生多个inotify事件，等都处理完再缓存一份有效的响应 */
+    render(true);
+    hits = responses->hits();
+    assert(render(true).find("<p>2</p>") != std::string::npos && responses->hits() == hits + 1);
+    std::vector<std::string> fillers;
+    for (int i = 0; i < 40; i++) {
+        fillers.push_back(root + "/e" + std::to_string(i));
+        WriteFile(fillers.back(), "x");
+    }
+    usleep(50 * 1000);
+    uint64_t evictions = cache->evictions();
+    for (const std::string& name: fillers) {
+        cache->get(name);
+    }
+    assert(cache->evictions() > evictions);
+    WriteFile(root + page, "<p>3</p>");
+    assert(WaitUntil([&] { return render(true).find("<p>3</p>") != std::string::npos; }));
+    for (const std::string& name: fillers) {
+        unlink(name.c_str());
+    }
+    response.unmapFile();
+    unlink((root + page).c_str());
+}
+
+void TestContentEncoding() {
+    /* 内容协商：q=0 拒绝，* 匹配其余编码 */
+    assert(HttpResponse::parseAcceptEncoding("gzip, deflate, br") == ((1 << FileCache::GZIP) | (1 << FileCache::BROTLI)));
+    assert(HttpResponse::parseAcceptEncoding("br;q=0, *") == (1 << FileCache::GZIP));
+    assert(HttpResponse::parseAcceptEncoding("gzip;q=0.000") == 0);
+
+    /* 即时压缩在压缩线程上进行，完成前先发送原文件；并发的未命中只压缩一次；更新的 .gz 预压缩文件优先 */
+    const std::string& root = CacheRoot();
+    FileCache* cache = FileCache::getInstance();
+    std::string css = "/s.css", body(4096, 'a');
+    WriteFile(root + css, body);
+    HttpResponse response;
+    auto negotiate = [&](const char* accept) { return Render(response, root, css, { accept }); };
+    usleep(50 * 1000);  /* 等写文件的inotify事件处理完，压缩期间的失效会让结果作废、重新提交 */
+    uint64_t compressions = cache->compressions();
+    std::string gz = negotiate("gzip");
+    assert(response.encoding() == FileCache::IDENTITY && gz.find("Vary: Accept-Encoding\r\n") != std::string::npos);
+    for (int i = 0; i < 100; i++) {
+        cache->getEncoded(root + css, cache->get(root + css), FileCache::GZIP);
+    }
+    assert(WaitUntil([&] { return negotiate("gzip").find("Content-Encoding: gzip\r\n") != std::string::npos; }));
+    gz = negotiate("gzip");
+    assert(response.encoding() == FileCache::GZIP && gz.size() < body.size() && cache->compressions() == compressions + 1);
+    std::shared_ptr<const FileEntry> compressed = cache->getEncoded(root + css, cache->get(root + css), FileCache::GZIP);
+    assert(cache->getEncoded(root + css, cache->get(root + css), FileCache::GZIP) == compressed);
+    assert(WaitUntil([&] { return negotiate("br").find("Content-Encoding: br\r\n") != std::string::npos; }));
+    assert(negotiate("identity").find("Content-Encoding") == std::string::npos);
+
+    WriteFile(root + css + ".gz", "pre");
+    assert(WaitUntil([&] { return negotiate("gzip").find("\r\n\r\npre") != std::string::npos; }));
+    response.unmapFile();
+    unlink((root + css + ".gz").c_str());
+    unlink((root + css).c_str());
+}
+
+void TestConditionalGet() {
+    /* 条件请求：校验器匹配时返回不带报文体的304，编码不同的表示ETag不同 */
+    const std::string& root = CacheRoot();
+    FileCache* cache = FileCache::getInstance();
+    std::string css = "/c.css";
+    WriteFile(root + css, std::string(4096, 'c'));
+    HttpResponse response;
+    auto conditional = [&](HttpResponse::RequestHeaders headers) { return Render(response, root, css, headers); };
+    assert(WaitUntil([&] { return conditional({ "gzip" }).find("Content-Encoding: gzip\r\n") != std::string::npos; }));
+    std::string etag = cache->get(root + css)->etag, lastModified = cache->get(root + css)->lastModified;
+    std::string notModified = conditional({ "", etag });
+    assert(notModified.find("HTTP/1.1 304 Not Modified\r\n") == 0 && notModified.find("ETag: " + etag) != std::string::npos);
+    assert(notModified.find("Content-length") == std::string::npos && response.fileLen() == 0 && response.fileFd() < 0);
+    assert(conditional({ "", "\"x\", W/" + etag }).find(" 304 ") != std::string::npos);
+    assert(conditional({ "gzip", etag }).find(" 200 ") != std::string::npos);
+    assert(conditional({ "", "\"x\"", lastModified }).find(" 200 ") != std::string::npos);
+    assert(conditional({ "", std::string_view(), lastModified }).find(" 304 ") != std::string::npos);
+    assert(conditional({ "", std::string_view(), "Thu, 01 Jan 1970 00:00:00 GMT" }).find(" 200 ") != std::string::npos);
+    assert(conditional({ "", std::string_view(), "Fri, 01 Jan 2100 00:00:00 GMT" }).find(" 304 ") != std::string::npos);
+    response.unmapFile();
+    unlink((root + css).c_str());
+}
+
+/* 生成响应并检查Content-length与实际报文体一致 */
+static std::string RenderChecked(HttpResponse& response, const std::string& root, const std::string& path,
+                                 HttpResponse::RequestHeaders headers = {}, bool isKeepAlive = true, int code = 200) {
+    std::string out = Render(response, root, path, headers, isKeepAlive, code);
+    size_t bodyBegin = out.find("\r\n\r\n") + 4, lenPos = out.find("Content-length: ");
+    assert(lenPos != std::string::npos && std::stoul(out.substr(lenPos + 16)) == out.size() - bodyBegin);
+    return out;
+}
+
+void TestRangeRequest() {
+    /* 区间请求：大文件（sendfile）与小文件（内存）都按HttpConn的方式把首部与各段内容拼起来检查 */
+    const std::string& root = CacheRoot();
+    std::string video = "/v.avi", css = "/r.css", content;
+    for (int k = 0; k < 20000; k++) { content += char('a' + k % 26); }
+    WriteFile(root + video, content);
+    WriteFile(root + css, std::string(4096, 'a'));
+    HttpResponse response;
+    auto ranged = [&](const std::string& name, HttpResponse::RequestHeaders headers) {
+        return RenderChecked(response, root, name, headers);
+    };
+    std::string single = ranged(video, { "", {}, {}, "bytes=10-19" });
+    assert(single.find("HTTP/1.1 206 Partial Content\r\n") == 0 && single.find("Content-Range: bytes 10-19/20000\r\n") != std::string::npos);
+    assert(single.compare(single.size() - 10, 10, content, 10, 10) == 0);
+    std::string suffix = ranged(video, { "", {}, {}, "bytes=-5" });
+    assert(suffix.find("bytes 19995-19999/20000") != std::string::npos && suffix.compare(suffix.size() - 5, 5, content, 19995, 5) == 0);
+    std::string multi = ranged(video, { "", {}, {}, "bytes=100-101, 0-1" });
+    assert(multi.find("Content-type: multipart/byteranges; boundary=") != std::string::npos);
+    assert(multi.find("Content-Range: bytes 0-1/20000\r\n\r\nab\r\n--") < multi.find("Content-Range: bytes 100-101/20000\r\n\r\nwx\r\n--"));
+    assert(multi.compare(multi.size() - 4, 4, "--\r\n") == 0);
+    assert(ranged(video, { "", {}, {}, "bytes=0-5,3-9" }).find("Content-Range: bytes 0-9/20000") != std::string::npos);
+    std::string unsatisfiable = ranged(video, { "", {}, {}, "bytes=20000-" });
+    assert(unsatisfiable.find(" 416 ") != std::string::npos && unsatisfiable.find("Content-Range: bytes */20000") != std::string::npos);
+    assert(ranged(video, { "", {}, {}, "bytes=x" }).find(" 200 ") != std::string::npos);
+    assert(ranged(video, { "", {}, {}, "bytes=0-1", "\"stale\"" }).size() > content.size());
+    std::string videoEtag = FileCache::getInstance()->get(root + video)->etag;
+    assert(ranged(video, { "", {}, {}, "bytes=0-1", videoEtag }).find(" 206 ") != std::string::npos);
+    std::string small = ranged(css, { "gzip", {}, {}, "bytes=0-0" });
+    assert(small.find(" 206 ") != std::string::npos && small.find("Content-Encoding") == std::string::npos);
+    assert(small.compare(small.size() - 1, 1, "a") == 0);
+    response.unmapFile();
+    unlink((root + video).c_str());
+    unlink((root + css).c_str());
+}
+
+void TestMimeTypes() {
+    /* 类型按后缀（不区分大小写）查编译期生成的表，未知后缀为text/plain */
+    const std::string& root = CacheRoot();
+    struct {
+        const char* name;
+        const char* type;
+    } types[] = {
+        { "/f.woff2", "font/woff2" }, { "/f.WOFF", "font/woff" }, { "/i.svg", "image/svg+xml" },
+        { "/m.mp4", "video/mp4" }, { "/d.json", "application/json" }, { "/a.b/noext", "text/plain" }, { "/x.unknown", "text/plain" },
+    };
+    HttpResponse response;
+    mkdir((root + "/a.b").c_str(), 0755);
+    for (auto& t: types) {
+        std::string name = t.name;
+        WriteFile(root + name, "0123456789");
+        std::string head = RenderChecked(response, root, name);
+        assert(head.find(std::string("Content-type: ") + t.type + "\r\n") != std::string::npos);
+        unlink((root + name).c_str());
+    }
+    response.unmapFile();
+    rmdir((root + "/a.b").c_str());
+}
+
+void TestErrorPages() {
+    /* 错误页启动时读入内存，之后的错误响应不再访问文件；读不到的页使用内置内容 */
+    const std::string& root = CacheRoot();
+    WriteFile(root + "/404.html", "<p>nf</p>");
+    HttpResponse::loadErrorPages(root);
+    unlink((root + "/404.html").c_str());
+    HttpResponse response;
+    auto error = [&](const char* name, int code) {
+        std::string out = RenderChecked(response, root, name, {}, code != 400, code);
+        assert(out.find("\r\nDate: ") != std::string::npos);
+        return out;
+    };
+    std::string notFound = error("/nothing", -1);
+    assert(notFound.find("HTTP/1.1 404 Not Found\r\n") == 0 && notFound.compare(notFound.size() - 9, 9, "<p>nf</p>") == 0);
+    std::string notAllowed = error("/index.html", 405);
+    assert(notAllowed.find("Allow: GET, HEAD, POST\r\n") != std::string::npos && notAllowed.find("405 : Method Not Allowed") != std::string::npos);
+    assert(error("/x", 400).find("Connection: close\r\n") != std::string::npos);
+    assert(error("/x", 500).find("HTTP/1.1 500 Internal Server Error\r\n") == 0);
+}
+
+void TestAssetPack() {
+    /* 切换到资源包后FileCache不再回到文件系统模式，须是最后一个使用缓存目录的测试 */
+    const std::string& root = CacheRoot();
+    FileCache* cache = FileCache::getInstance();
+    std::string page = "/page.html", css = "/s.css", txt = "/a.txt", big = "/big.bin", body(4096, 'a');
+    std::string bigBody(FileCache::sendfileThreshold + 100, 'g');
+    WriteFile(root + page, "<p>pack</p>");
+    WriteFile(root + big, bigBody);
+    WriteFile(root + css, body);
+    WriteFile(root + css + ".gz", "pre");
+    WriteFile(root + txt, "hello");
+
+    /* 资源包：按路径散列查找，压缩版本打包时生成（较新的预压缩文件优先），损坏的包拒绝加载 */
+    std::string packPath = root + ".pack";
+    assert(AssetPack::build(root, packPath));
+    std::shared_ptr<AssetPack> pack = AssetPack::open(packPath);
+    assert(pack && pack->find(page) && !pack->find("/nothing") && !pack->find("page.html"));
+    const PackEntry* packedCss = pack->find(css);
+    assert(packedCss->len[FileCache::IDENTITY] == body.size() && packedCss->len[FileCache::BROTLI] > 0);
+    assert(std::string(pack->data(*packedCss, FileCache::GZIP), packedCss->len[FileCache::GZIP]) == "pre");
+    assert(pack->find(txt)->len[FileCache::GZIP] == 0);
+    std::string corrupt = root + ".bad";
+    struct stat packSt;
+    assert(AssetPack::build(root, corrupt) && stat(corrupt.c_str(), &packSt) == 0);
+    assert(truncate(corrupt.c_str(), packSt.st_size / 2) == 0);
+    assert(!AssetPack::open(corrupt) && !cache->loadPack(corrupt));
+    unlink(corrupt.c_str());
+
+    /* 散列槽不足条目数两倍时查找可能遇不到空槽而一直探测，拒绝加载 */
+    char fullDir[] = "/tmp/packslotXXXXXX";
+    assert(mkdtemp(fullDir));
+    for (int i = 0; i < 4; i++) { WriteFile(std::string(fullDir) + "/f" + std::to_string(i), "x"); }
+    std::string full = root + ".full";
+    assert(AssetPack::build(fullDir, full));
+    PackHeader header;
+    int fullFd = open(full.c_str(), O_RDWR);
+    assert(pread(fullFd, &header, sizeof(header), 0) == sizeof(header) && header.count == 4);
+    uint32_t fullSlots[4] = { 1, 2, 3, 4 };
+    header.slotNum = 4;
+    assert(pwrite(fullFd, &header, sizeof(header), 0) == sizeof(header));
+    assert(pwrite(fullFd, fullSlots, sizeof(fullSlots), header.slotOff) == sizeof(fullSlots));
+    close(fullFd);
+    assert(!AssetPack::open(full));
+    unlink(full.c_str());
+    for (int i = 0; i < 4; i++) { unlink((std::string(fullDir) + "/f" + std::to_string(i)).c_str()); }
+    rmdir(fullDir);
+
+    /* 切换到资源包后只从包中取文件，条目直接引用映射；之前缓存的整条响应不再使用 */
+    HttpResponse response;
+    assert(cache->loadPack(packPath) && cache->packed());
+    std::shared_ptr<const FileEntry> packedPage = cache->get(root + page);
+    assert(packedPage->pack && std::string(packedPage->data, packedPage->st.st_size) == "<p>pack</p>");
+    std::string later = root + "/later.txt";
+    WriteFile(later, "later");
+    assert(!cache->get(later)->exists && !cache->get("/etc/passwd")->exists);
+    std::string packedBr = Render(response, root, css, { "br" });
+    assert(packedBr.find("Content-Encoding: br\r\n") != std::string::npos);
+    assert(packedBr.find(std::string("ETag: ") + std::string(pack->etag(*packedCss)).substr(0, 17) + "-br\"") != std::string::npos);
+    assert(Render(response, root, page).find("<p>pack</p>") != std::string::npos);
+    /* 包中的大文件不整条渲染复制，直接引用映射 */
+    size_t rendered = ResponseCache::getInstance()->size();
+    std::string bigOut = Render(response, root, big);
+    assert(bigOut.compare(bigOut.size() - bigBody.size(), bigBody.size(), bigBody) == 0);
+    assert(response.fileFd() < 0 && response.file() == cache->get(root + big)->data);
+    assert(ResponseCache::getInstance()->size() == rendered);
+
+    /* 包被rename替换后自动重新加载，已取得的旧条目依然可用 */
+    std::string newPack = root + ".new";
+    assert(AssetPack::build(root, newPack) && rename(newPack.c_str(), packPath.c_str()) == 0);
+    assert(WaitUntil([&] { return cache->get(later)->exists; }));
+    assert(packedPage->stale && std::string(packedPage->data, packedPage->st.st_size) == "<p>pack</p>");
+
+    /* 原地改写不触发重新加载，只认rename；这里写回相同内容，映射仍然有效 */
+    std::shared_ptr<const FileEntry> current = cache->get(root + page);
+    std::string packData;
+    FILE* packFp = fopen(packPath.c_str(), "r");
+    char chunk[4096];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), packFp)) > 0; ) { packData.append(chunk, n); }
+    fclose(packFp);
+    WriteFile(packPath, packData);
+    usleep(100 * 1000);
+    assert(!current->stale && cache->get(root + page) == current);
+    current.reset();
+    pack.reset();
+    packedPage.reset();
+    unlink(packPath.c_str());
+    unlink(later.c_str());
+
+    response.unmapFile();
+    unlink((root + css + ".gz").c_str());
+    unlink((root + css).c_str());
+    unlink((root + page).c_str());
+    unlink((root + txt).c_str());
+    unlink((root + big).c_str());
+    rmdir(root.c_str());
+}
+
+void TestBufferPool() {
+    /* 同一线程归还的块再次取用时命中，超过最大级别的块不入池 */
+    size_t size = 3000;
+    char* block = BufferPool::acquire(size);
+    assert(size == 4096);
+    BufferPool::release(block, size);
+    uint64_t hits = BufferPool::hits();
+    size = 2049;
+    assert(BufferPool::acquire(size) == block && size == 4096 && BufferPool::hits() == hits + 1);
+    BufferPool::release(block, size);
+    size_t cached = BufferPool::cachedBytes();
+    size = BufferPool::MAX_BLOCK + 1;
+    char* large = BufferPool::acquire(size);
+    assert(size == BufferPool::MAX_BLOCK + 1);
+    BufferPool::release(large, size);
+    assert(BufferPool::cachedBytes() == cached);
+
+    /* 缓冲区首次写入时才挂上块，扩容保留数据，retrieveAll后归还 */
+    size_t resident = BufferPool::residentBytes();
+    {
+        Buffer buff(8);
+        assert(buff.writableBytes() == 0 && BufferPool::residentBytes() == resident);
+        buff.append("abc", 3);
+        assert(buff.writableBytes() == BufferPool::MIN_BLOCK - 3);
+        buff.retrieve(1);
+        buff.append(std::string(5000, 'x'));
+        assert(buff.readableBytes() == 5002 && std::string(buff.peek(), 2) == "bc");
+        assert(buff.peek()[5001] == 'x');
+        cached = BufferPool::cachedBytes();
+        buff.retrieveAll();
+        assert(buff.writableBytes() == 0 && BufferPool::cachedBytes() > cached);
+    }
+}
+
+void TestChainBuffer() {
+    /* 自有字节写满一块后另起一块，已写入的数据不搬移；相邻写入合并为一段 */
+    ChainBuffer chain(BufferPool::MIN_BLOCK);
+    chain.append("GET ");
+    chain.append("/ ");
+    assert(chain.segmentCount() == 1 && chain.readableBytes() == 6);
+    struct iovec iov[8];
+    assert(chain.peekIov(iov, 8) == 1);
+    const char* first = static_cast<const char*>(iov[0].iov_base);
+    chain.append(std::string(BufferPool::MIN_BLOCK, 'x'));
+    assert(chain.segmentCount() == 2 && chain.peekIov(iov, 8) == 2 && iov[0].iov_base == first);
+
+    /* 引用的外部内存在取走之前由keeper保持有效；文件区间打断iovec */
+    std::shared_ptr<std::string> body = std::make_shared<std::string>("<html>");
+    std::weak_ptr<std::string> watch = body;
+    chain.appendRef(body->data(), body->size(), body);
+    body.reset();
+    chain.appendFile(0, 100, 50);
+    chain.append("tail");
+    bool more;
+    assert(chain.peekIov(iov, 8, &more) == 3 && more && iov[2].iov_base == watch.lock()->data());
+    assert(chain.readableBytes() == 6 + BufferPool::MIN_BLOCK + 6 + 50 + 4);
+
+    /* split与retrieve只调整段的边界 */
+    ChainBuffer head;
+    chain.split(4, head);
+    assert(head.readableBytes() == 4 && head.peekIov(iov, 8) == 1 && iov[0].iov_base == first);
+    assert(chain.peekIov(iov, 8) == 3 && iov[0].iov_base == first + 4 && iov[0].iov_len == BufferPool::MIN_BLOCK - 4);
+    chain.retrieve(2 + BufferPool::MIN_BLOCK + 3);
+    assert(chain.peekIov(iov, 8) == 1 && std::string(static_cast<char*>(iov[0].iov_base), iov[0].iov_len) == "ml>");
+    chain.retrieve(3);
+    assert(watch.expired());
+    int fd;
+    off_t off;
+    size_t len;
+    chain.retrieve(10);
+    assert(chain.peekIov(iov, 8) == 0 && chain.peekFile(fd, off, len) && fd == 0 && off == 110 && len == 40);
+    chain.retrieve(40);
+    assert(chain.peekIov(iov, 8, &more) == 1 && !more && iov[0].iov_len == 4);
+    chain.retrieve(4);
+    assert(chain.empty() && chain.segmentCount() == 0);
+}
+
+/* 处理并发出读缓冲区中的全部请求，对端读出丢弃 */
+static void DrainConn(HttpConn& conn, int peer) {
+    char buf[65536];
+    int err = 0;
+    while (conn.process()) {
+        while (conn.toWriteBytes() > 0) {
+            conn.write(&err);
+            while (recv(peer, buf, sizeof(buf), MSG_DONTWAIT) > 0) {}
+        }
+    }
+}
+
+void TestBackpressure() {
+    size_t high = HttpConn::readHighWater, low = HttpConn::readLowWater, budget = HttpConn::maxBufferedBytes;
+    HttpConn::readHighWater = 4096;
+    HttpConn::readLowWater = 1024;
+    HttpConn::isET = true;
+    HttpConn::srcDir = "/nonexistent/";
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    std::string reqs;
+    for (int i = 0; i < 200; i++) { reqs += "GET /a HTTP/1.1\r\nHost: x\r\n\r\n"; }
+    assert(write(sv[1], reqs.data(), reqs.size()) == (ssize_t)reqs.size());
+
+    /* 超过高水位后停止读取，处理掉流水线请求回落到低水位以下才恢复 */
+    HttpConn conn;
+    conn.init(sv[0], sockaddr_in());
+    int err = 0;
+    assert(conn.read(&err) > 0 && conn.isReadPaused() && HttpConn::pausedCount == 1);
+    assert(conn.bufferedBytes() == reqs.size() && HttpConn::totalBuffered == reqs.size());
+    /* 一批最多处理MAX_PIPELINE个请求，剩余部分仍在高低水位之间 */
+    assert(conn.process() && conn.isReadPaused());
+    while (conn.toWriteBytes() > 0) { conn.write(&err); }
+    DrainConn(conn, sv[1]);
+    assert(!conn.isReadPaused() && HttpConn::pausedCount == 0 && conn.bufferedBytes() == 0);
+
+    /* 所有连接合计超过预算时同样暂停，降到预算的3/4以下后恢复 */
+    HttpConn::maxBufferedBytes = 2048;
+    assert(write(sv[1], reqs.data(), 28 * 100) == 28 * 100);
+    assert(conn.read(&err) > 0 && conn.isReadPaused() && !conn.resumeRead());
+    DrainConn(conn, sv[1]);
+    assert(conn.resumeRead() && HttpConn::totalBuffered == 0);
+    /* 边沿触发下读到EAGAIN为止 */
+    assert(write(sv[1], reqs.data(), 28) == 28 && conn.read(&err) < 0 && err == EAGAIN);
+    assert(conn.bufferedBytes() == 28 && !conn.isReadPaused());
+    conn.closeConn();
+    assert(HttpConn::totalBuffered == 0 && HttpConn::pausedCount == 0);
+    close(sv[1]);
+
+    /* 因预算暂停时持有超过低水位的半个请求首部，其他连接释放后要能恢复，否则首部永远收不全 */
+    HttpConn::readHighWater = high;
+    HttpConn::readLowWater = low;
+    HttpConn::maxBufferedBytes = 64 * 1024;
+    std::string head = "GET /a HTTP/1.1\r\nX-Pad: " + std::string(40 * 1024, 'p');
+    int other[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0 && socketpair(AF_UNIX, SOCK_STREAM, 0, other) == 0);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    fcntl(other[0], F_SETFL, O_NONBLOCK);
+    HttpConn busy;
+    busy.init(other[0], sockaddr_in());
+    assert(write(other[1], head.data(), head.size()) == (ssize_t)head.size());
+    busy.read(&err);
+    assert(busy.bufferedBytes() == head.size() && !busy.isReadPaused());
+    conn.init(sv[0], sockaddr_in());
+    assert(write(sv[1], head.data(), head.size()) == (ssize_t)head.size());
+    conn.read(&err);
+    assert(conn.isReadPaused() && conn.bufferedBytes() == head.size() && head.size() > low);
+    assert(!conn.process() && !conn.resumeRead());
+    busy.closeConn();
+    close(other[1]);
+    assert(conn.resumeRead() && conn.bufferedBytes() == head.size());
+    assert(write(sv[1], "\r\n\r\n", 4) == 4);
+    conn.read(&err);
+    assert(conn.process() && conn.toWriteBytes() > 0);
+    conn.closeConn();
+    assert(HttpConn::totalBuffered == 0 && HttpConn::pausedCount == 0);
+    close(sv[1]);
+
+    HttpConn::readHighWater = high;
+    HttpConn::readLowWater = low;
+    HttpConn::maxBufferedBytes = budget;
+    HttpConn::isET = false;
+}
+
+/* 请求经socketpair交给HttpConn处理，返回对端收到的全部字节 */
+static std::string Exchange(HttpConn& conn, int peer, const std::string& reqs) {
+    assert(write(peer, reqs.data(), reqs.size()) == (ssize_t)reqs.size());
+    std::string out;
+    char buf[65536];
+    ssize_t n;
+    int err = 0;
+    conn.read(&err);
+    while (conn.process()) {
+        while (conn.toWriteBytes() > 0) {
+            conn.write(&err);
+            while ((n = recv(peer, buf, sizeof(buf), MSG_DONTWAIT)) > 0) { out.append(buf, n); }
+        }
+    }
+    return out;
+}
+
+/* 从pos处取出一个响应：返回首部，报文体按Content-length写入body */
+static std::string NextResponse(const std::string& out, size_t& pos, bool isHead, std::string* body = nullptr) {
+    size_t end = out.find("\r\n\r\n", pos);
+    assert(end != std::string::npos);
+    std::string head = out.substr(pos, end + 4 - pos);
+    size_t lenPos = head.find("Content-length: ");
+    size_t len = lenPos == std::string::npos ? 0 : std::stoul(head.substr(lenPos + 16));
+    pos = end + 4;
+    if (!isHead) {
+        assert(out.size() - pos >= len);
+        if (body) { *body = out.substr(pos, len); }
+        pos += len;
+    }
+    return head;
+}
+
+void TestHeadRequest() {
+    /* HEAD的首部与GET相同但不带报文体，流水线上后续响应的边界不受影响 */
+    char dir[] = "/tmp/headXXXXXX";
+    assert(mkdtemp(dir));
+    std::string root = dir, big(FileCache::sendfileThreshold + 100, 'b');
+    WriteFile(root + "/a.html", "<p>hi</p>");
+    WriteFile(root + "/big.bin", big);
+    HttpConn::srcDir = dir;
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    HttpConn conn;
+    conn.init(sv[0], sockaddr_in());
+    std::string out = Exchange(conn, sv[1],
+        "HEAD /a.html HTTP/1.1\r\nHost: x\r\n\r\nGET /a.html HTTP/1.1\r\nHost: x\r\n\r\n"
+        "HEAD /big.bin HTTP/1.1\r\nHost: x\r\n\r\nGET /big.bin HTTP/1.1\r\nHost: x\r\n\r\n"
+        "HEAD /missing HTTP/1.1\r\nHost: x\r\n\r\nGET /a.html HTTP/1.1\r\nHost: x\r\n\r\n");
+    size_t pos = 0;
+    std::string body;
+    std::string headSmall = NextResponse(out, pos, true);
+    std::string getSmall = NextResponse(out, pos, false, &body);
+    assert(headSmall.find("HTTP/1.1 200 OK\r\n") == 0 && body == "<p>hi</p>");
+    assert(headSmall.find("Content-length: 9\r\n") != std::string::npos);
+    assert(headSmall.substr(headSmall.find("ETag: ")) == getSmall.substr(getSmall.find("ETag: ")));
+    std::string headBig = NextResponse(out, pos, true);
+    NextResponse(out, pos, false, &body);
+    assert(headBig.find("Content-length: " + std::to_string(big.size()) + "\r\n") != std::string::npos && body == big);
+    assert(NextResponse(out, pos, true).find("HTTP/1.1 404 Not Found\r\n") == 0);
+    NextResponse(out, pos, false, &body);
+    assert(body == "<p>hi</p>" && pos == out.size());
+    conn.closeConn();
+    close(sv[1]);
+    unlink((root + "/a.html").c_str());
+    unlink((root + "/big.bin").c_str());
+    rmdir(dir);
+}
+
+void TestPipeline() {
+    /* 超过一批上限的流水线请求按序全部响应；跨两次读取的请求在数据到齐后处理 */
+    char dir[] = "/tmp/pipeXXXXXX";
+    assert(mkdtemp(dir));
+    std::string root = dir;
+    WriteFile(root + "/a.html", "<p>a</p>");
+    WriteFile(root + "/b.html", "<p>bb</p>");
+    HttpConn::srcDir = dir;
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    HttpConn conn;
+    conn.init(sv[0], sockaddr_in());
+    const int COUNT = 40;
+    std::string reqs;
+    for (int i = 0; i <= COUNT; i++) {
+        reqs += std::string("GET /") + (i % 2 ? "b" : "a") + ".html HTTP/1.1\r\nHost: x\r\n\r\n";
+    }
+    size_t split = reqs.size() - 10;
+    std::string out = Exchange(conn, sv[1], reqs.substr(0, split));
+    out += Exchange(conn, sv[1], reqs.substr(split));
+    size_t pos = 0;
+    std::string body;
+    for (int i = 0; i <= COUNT; i++) {
+        assert(NextResponse(out, pos, false, &body).find("HTTP/1.1 200 OK\r\n") == 0);
+        assert(body == (i % 2 ? "<p>bb</p>" : "<p>a</p>"));
+    }
+    assert(pos == out.size() && conn.isKeepAlive());
+
+    /* Connection: close之后的请求不再处理，连接在发送完后关闭 */
+    reqs = "GET /a.html HTTP/1.1\r\nHost: x\r\n\r\n"
+           "GET /b.html HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n"
+           "GET /a.html HTTP/1.1\r\nHost: x\r\n\r\n";
+    assert(::write(sv[1], reqs.data(), reqs.size()) == static_cast<ssize_t>(reqs.size()));
+    int err = 0;
+    conn.read(&err);
+    assert(conn.process() && !conn.isKeepAlive());
+    while (conn.toWriteBytes() > 0) { assert(conn.write(&err) > 0); }
+    char buf[4096];
+    ssize_t n;
+    out.clear();
+    while ((n = recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0) { out.append(buf, n); }
+    pos = 0;
+    NextResponse(out, pos, false, &body);
+    assert(body == "<p>a</p>");
+    assert(NextResponse(out, pos, false, &body).find("Connection: close\r\n") != std::string::npos && body == "<p>bb</p>");
+    assert(pos == out.size());
+    conn.closeConn();
+    close(sv[1]);
+    unlink((root + "/a.html").c_str());
+    unlink((root + "/b.html").c_str());
+    rmdir(dir);
+}
+
+void TestTruncatedFile() {
+    /* 文件在发送中途被截断时sendfile返回0，不能沿用残留的errno（EAGAIN会让连接空转），要按错误关闭 */
+    char dir[] = "/tmp/truncXXXXXX";
+    assert(mkdtemp(dir));
+    std::string path = std::string(dir) + "/big.bin";
+    WriteFile(path, std::string(FileCache::sendfileThreshold + 100, 'b'));
+    HttpConn::srcDir = dir;
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    HttpConn conn;
+    conn.init(sv[0], sockaddr_in());
+    std::string req = "GET /big.bin HTTP/1.1\r\nHost: x\r\n\r\n";
+    assert(::write(sv[1], req.data(), req.size()) == static_cast<ssize_t>(req.size()));
+    int err = 0;
+    conn.read(&err);
+    assert(conn.process());
+    assert(truncate(path.c_str(), 0) == 0);
+    errno = EAGAIN;
+    err = 0;
+    assert(conn.write(&err) <= 0 && err == EIO && conn.toWriteBytes() > 0);
+    conn.closeConn();
+    close(sv[1]);
+    unlink(path.c_str());
+    rmdir(dir);
+}
+
+void TestUringPoller() {
+    UringPoller poller;
+    if (!poller.isValid()) {
+        return;     /* 内核不支持io_uring */
+    }
+    int a[2], b[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, a) == 0 && socketpair(AF_UNIX, SOCK_STREAM, 0, b) == 0);
+    char ch = 'x';
+    /* add/mod/remove：ONESHOT只触发一次，移除后不再触发 */
+    assert(poller.addFd(a[0], EPOLLIN, 1) && !poller.addFd(a[0], EPOLLIN, 1));
+    assert(poller.wait(0) == 0);
+    assert(::write(a[1], &ch, 1) == 1);
+    assert(poller.wait(1000) == 1 && poller.getEventData(0) == 1 && (poller.getEvents(0) & EPOLLIN));
+    assert(poller.modFd(a[0], EPOLLOUT | EPOLLONESHOT, 2));
+    assert(poller.wait(1000) == 1 && poller.getEventData(0) == 2 && poller.getEvents(0) == EPOLLOUT);
+    assert(poller.wait(20) == 0);
+    assert(poller.delFd(a[0]) && poller.wait(20) == 0);
+    assert(::read(a[0], &ch, 1) == 1);
+
+    /*
+     * 线程池模式：事件循环阻塞等待时由其他线程修改事件，新注册的事件立即生效；
+     * 其他线程可能在事件循环进入内核前就把它积攒的请求一起提交掉，此时等待也不能提前返回
+     */
+    std::atomic<int> round(-1);
+    std::thread worker([&] {
+        for (int i = 0; i < 2000; i++) {
+            while (round.load() != i) {}
+            assert(poller.modFd(b[0], EPOLLIN | EPOLLONESHOT, 0));
+            if (i % 2) { usleep(100); }
+            assert(::write(a[1], &ch, 1) == 1);
+        }
+    });
+    for (int i = 0; i < 2000; i++) {
+        assert(poller.modFd(a[0], EPOLLIN | EPOLLONESHOT, i + 1));
+        round = i;
+        assert(poller.wait(-1) == 1 && poller.getEventData(0) == static_cast<uint64_t>(i + 1));
+        assert(::read(a[0], &ch, 1) == 1);
+    }
+    worker.join();
+    close(a[0]);
+    close(a[1]);
+    close(b[0]);
+    close(b[1]);
+}
+
+void TestTimingWheel() {
+    /* 按到期时间依次触发，不早于超时时间；取消的结点不触发，刷新后推迟 */
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::pair<uint64_t, long>> fired;
+    WheelNode nodes[5];
+    TimingWheel wheel([&](uint64_t data) {
+        fired.push_back({data, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()});
+    });
+    wheel.add(&nodes[0], 30, 1);
+    wheel.add(&nodes[1], 10, 2);
+    wheel.add(&nodes[2], 300, 3);           /* 超过第0层一圈，经级联后到期 */
+    wheel.add(&nodes[3], 20, 4);
+    wheel.add(&nodes[4], 3600 * 1000, 5);   /* 在第3层 */
+    wheel.add(&nodes[3], 20, 4);
+    assert(wheel.size() == 5);
+    int next = wheel.getNextTick();
+    assert(next >= 0 && next <= 10);
+    wheel.cancel(&nodes[3]);
+    wheel.adjust(&nodes[0], 100);
+    int loops = 0;
+    /* 模拟事件循环：按getNextTick的返回值等待 */
+    while ((next = wheel.getNextTick()), fired.size() < 3) {
+        assert(next >= 0 && next <= 300);
+        usleep(next * 1000);
+        loops++;
+    }
+    assert(fired[0].first == 2 && fired[0].second >= 9);
+    assert(fired[1].first == 1 && fired[1].second >= 99);
+    assert(fired[2].first == 3 && fired[2].second >= 299);
+    assert(loops < 20 && wheel.size() == 1);
+    assert(next > 0 && !nodes[2].linked() && nodes[4].linked());
+
+    /* 已触发的结点刷新无效，doWork立即触发 */
+    wheel.adjust(&nodes[2], 10);
+    assert(!nodes[2].linked());
+    wheel.doWork(&nodes[4]);
+    assert(fired.size() == 4 && fired[3].first == 5);
+    assert(wheel.size() == 0 && wheel.getNextTick() == -1);
+}
+
+void TestConnTable() {
+    /* fd复用后旧连接残留的事件与定时器凭代数识别为过期；同一fd的HttpConn与定时结点地址不变 */
+    ConnTable table(64);
+    assert(table.open(-1) == 0 && table.open(64) == 0);
+    uint64_t first = table.open(5);
+    assert(first != 0 && ConnTable::keyFd(first) == 5 && table.key(5) == first);
+    HttpConn* conn = table.lookup(first);
+    WheelNode* node = table.timerNode(5);
+    assert(conn != nullptr);
+    uint64_t second = table.open(5);
+    assert(second != first && ConnTable::keyFd(second) == 5 && table.key(5) == second);
+    assert(table.lookup(first) == nullptr && table.lookup(second) == conn && table.timerNode(5) == node);
+    /* 未打开过的槽位、越界的fd都查不到连接 */
+    assert(table.lookup(table.key(6)) == nullptr && table.lookup(100) == nullptr);
+    assert(table.lookup((first & ~0xffffffffULL) | 6) == nullptr);
+    assert(ConnTable::limitFd(16) <= 16);
+}
+
+void TestLockFreeQueue() {
+    /* 容量取整为2的幂，满时push失败 */
+    LockFreeQueue<int> small(3);
+    int v;
+    assert(small.capacity() == 4 && small.empty() && !small.pop(v));
+    for (int i = 0; i < 4; i++) { assert(small.push(i)); }
+    assert(!small.push(4) && small.size() == 4);
+    assert(small.pop(v) && v == 0 && small.push(4));
+
+    /* 单生产者单消费者：所有元素按序到达，不丢不重 */
+    const uint64_t COUNT = 1000000;
+    LockFreeQueue<uint64_t> queue(64);
+    std::thread producer([&] {
+        for (uint64_t i = 1; i <= COUNT; i++) {
+            while (!queue.push(i)) { std::this_thread::yield(); }
+        }
+    });
+    uint64_t expect = 1, item;
+    while (expect <= COUNT) {
+        if (queue.pop(item)) {
+            assert(item == expect);
+            expect++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    assert(queue.empty() && !queue.pop(item));
+}
+
+static int Listen(uint16_t& port, bool reusePort) {
+    /* port为0时绑定任意端口并回填 */
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (reusePort) { setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)); }
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t len = sizeof(addr);
+    assert(bind(fd, (struct sockaddr*)&addr, len) == 0 && listen(fd, 128) == 0);
+    assert(getsockname(fd, (struct sockaddr*)&addr, &len) == 0);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int Fetch(uint16_t port, const std::string& body) {
+    /* 建立长连接取一次文件，返回仍打开的连接 */
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct timeval tv = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    assert(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    std::string req = "GET /a.html HTTP/1.1\r\nHost: x\r\nConnection: keep-alive\r\n\r\n", out;
+    assert(::write(fd, req.data(), req.size()) == static_cast<ssize_t>(req.size()));
+    char buf[4096];
+    ssize_t len;
+    while (out.size() < body.size() || out.compare(out.size() - body.size(), body.size(), body) != 0) {
+        /* 设了SO_RCVTIMEO的阻塞读会被io_uring的task_work通知打断而返回EINTR */
+        while ((len = ::read(fd, buf, sizeof(buf))) < 0 && errno == EINTR) {}
+        assert(len > 0);
+        out.append(buf, len);
+    }
+    assert(out.find("HTTP/1.1 200 OK\r\n") == 0);
+    return fd;
+}
+
+void TestReactorModes() {
+    /* 三种分发方式下连接都被接管并得到响应，多个Reactor时连接分散到各个循环上 */
+    char dir[] = "/tmp/reactorXXXXXX";
+    assert(mkdtemp(dir));
+    std::string body = "<p>hi</p>";
+    WriteFile(std::string(dir) + "/a.html", body);
+    HttpConn::srcDir = dir;
+    HttpConn::isET = false;
+    const uint32_t listenEvent = EPOLLRDHUP, connEvent = EPOLLONESHOT | EPOLLRDHUP;
+    const int COUNT = 32;
+    for (int backend: { Poller::EPOLL, Poller::IO_URING }) {
+        for (int mode = 0; mode < 3; mode++) {
+            ConnTable table(4096);
+            ThreadPool pool(2);
+            std::vector<std::unique_ptr<Reactor>> reactors;
+            std::vector<int> listenFds;
+            uint16_t port = 0;
+            size_t num = (mode == 0) ? 1 : 2;
+            for (size_t i = 0; i < num; i++) {
+                reactors.emplace_back(new Reactor(&table, 60000, listenEvent, connEvent, backend,
+                                                  mode == 0 ? &pool : nullptr));
+                if (mode == 2) { continue; }
+                /* 0：单Reactor+线程池；1：每个Reactor一个SO_REUSEPORT监听socket */
+                listenFds.push_back(Listen(port, mode == 1));
+                assert(reactors.back()->addListen(listenFds.back()));
+                Reactor::setFdNonblock(listenFds.back());
+            }
+            std::vector<std::thread> threads;
+            for (auto& reactor: reactors) {
+                threads.emplace_back(&Reactor::loop, reactor.get());
+            }
+            std::thread acceptor;
+            if (mode == 2) {
+                /* 2：主从Reactor，由本线程代替主Reactor accept后轮流投递 */
+                listenFds.push_back(Listen(port, false));
+                acceptor = std::thread([&] {
+                    for (int i = 0; i < COUNT; i++) {
+                        struct sockaddr_in addr;
+                        socklen_t len = sizeof(addr);
+                        int fd = accept(listenFds[0], (struct sockaddr*)&addr, &len);
+                        assert(fd > 0 && reactors[i % num]->queueClient(fd, addr));
+                    }
+                });
+            }
+            std::vector<int> clients;
+            for (int i = 0; i < COUNT; i++) {
+                clients.push_back(Fetch(port, body));
+            }
+            if (acceptor.joinable()) { acceptor.join(); }
+            int total = 0;
+            for (auto& reactor: reactors) {
+                assert(reactor->connCount() > 0);
+                total += reactor->connCount();
+            }
+            assert(total == COUNT);
+            if (mode == 2) {
+                assert(reactors[0]->connCount() == COUNT / 2);
+            }
+            for (int fd: clients) {
+                close(fd);
+            }
+            assert(WaitUntil([&] {
+                for (auto& reactor: reactors) {
+                    if (reactor->connCount() != 0) { return false; }
+                }
+                return true;
+            }));
+            for (auto& reactor: reactors) {
+                reactor->quit();
+            }
+            for (auto& t: threads) {
+                t.join();
+            }
+            for (int fd: listenFds) {
+                close(fd);
+            }
+        }
+    }
+    unlink((std::string(dir) + "/a.html").c_str());
+    rmdir(dir);
+}
+
+void TestSendfileWindow() {
+    /* 大文件的窗口随正在发送大文件的连接数缩小，不低于MIN_FILE_WINDOW，由TCP_NOTSENT_LOWAT体现；发送完后不再计入 */
+    char dir[] = "/tmp/windowXXXXXX";
+    assert(mkdtemp(dir));
+    std::string path = std::string(dir) + "/big.bin", content;
+    for (int i = 0; i < 8 * 1024 * 1024; i++) { content += char('a' + i % 26); }
+    WriteFile(path, content);
+    HttpConn::srcDir = dir;
+    size_t fileWindow = HttpConn::fileWindow, maxFileInflight = HttpConn::maxFileInflight;
+    HttpConn::fileWindow = 64 * 1024;
+    HttpConn::maxFileInflight = 128 * 1024;
+
+    uint16_t port = 0;
+    int listenFd = Listen(port, false);
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    assert(connect(client, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    int fd = accept(listenFd, nullptr, nullptr);
+    assert(fd > 0);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    HttpConn conn;
+    conn.init(fd, addr);
+    auto lowat = [&] {
+        int value = 0;
+        socklen_t len = sizeof(value);
+        assert(getsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &value, &len) == 0);
+        return value;
+    };
+
+    int streams = HttpConn::streamCount;
+    std::string req = "GET /big.bin HTTP/1.1\r\nHost: x\r\n\r\n";
+    assert(::write(client, req.data(), req.size()) == static_cast<ssize_t>(req.size()));
+    int err = 0;
+    conn.read(&err);
+    assert(conn.process() && HttpConn::streamCount == streams + 1);
+    /* 对端不读取，发送很快因窗口与接收缓冲区满而EAGAIN */
+    conn.write(&err);
+    assert(lowat() == 64 * 1024 && conn.toWriteBytes() > 0);
+    HttpConn::streamCount += 3;
+    conn.write(&err);
+    assert(lowat() == 32 * 1024);
+    HttpConn::streamCount += 100;
+    conn.write(&err);
+    assert(lowat() == static_cast<int>(HttpConn::MIN_FILE_WINDOW));
+    HttpConn::streamCount -= 103;
+
+    std::string out;
+    char buf[65536];
+    ssize_t n;
+    size_t bodyBegin = std::string::npos;
+    while (bodyBegin == std::string::npos || out.size() - bodyBegin < content.size()) {
+        if (conn.toWriteBytes() > 0) { conn.write(&err); }
+        while ((n = recv(client, buf, sizeof(buf), MSG_DONTWAIT)) > 0) { out.append(buf, n); }
+        if (bodyBegin == std::string::npos && out.find("\r\n\r\n") != std::string::npos) {
+            bodyBegin = out.find("\r\n\r\n") + 4;
+        }
+    }
+    assert(conn.toWriteBytes() == 0);
+    assert(out.find("HTTP/1.1 200 OK\r\n") == 0 && out.compare(bodyBegin, std::string::npos, content) == 0);
+    assert(HttpConn::streamCount == streams);
+
+    conn.closeConn();
+    close(client);
+    close(listenFd);
+    HttpConn::fileWindow = fileWindow;
+    HttpConn::maxFileInflight = maxFileInflight;
+    unlink(path.c_str());
+    rmdir(dir);
+}
+
 int main() {
+    TestTimingWheel();
+    TestBufferPool();
+    TestChainBuffer();
+    TestBackpressure();
+    TestHeadRequest();
+    TestPipeline();
+    TestTruncatedFile();
+    TestUringPoller();
+    TestConnTable();
+    TestLockFreeQueue();
+    TestReactorModes();
+    TestSendfileWindow();
+    TestHttpRequest();
+    TestFileCache();
+    TestResponseCache();
+    TestContentEncoding();
+    TestConditionalGet();
+    TestRangeRequest();
+    TestMimeTypes();
+    TestErrorPages();
+    TestAssetPack();
     TestLog();
     TestThreadPool();
 }
\ No newline at end of file